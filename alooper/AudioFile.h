@@ -1,4 +1,3 @@
-
 /*
  * AudioFile.h
  *
@@ -11,9 +10,23 @@
 #include <iostream>
 #include <cstring>
 #include <new>
+#include <thread>
+#include <vector>
 #include <sndfile.hh>
 
+#if defined(__linux__) || defined(__FreeBSD__) || \
+    defined(__NetBSD__) || defined(__OpenBSD__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define HAVE_MMAP 1
+#endif
+
 #include "CheckResample.h"
+#include "DiskStream.h"
+#include "SampleCache.h"
+#include "SampleConvert.h"
 
 
 #pragma once
@@ -23,7 +36,18 @@
 
 /****************************************************************
         class AudioFile - load a Audio File into buffer
-                          and resample when needed
+                          and resample when needed,
+                          or stream it from disk when it is to large,
+                          map float wave files directly into memory,
+                          decode progressive while playback starts,
+                          keep decoded and resampled data in a disk cache,
+                          hold 16 bit files as 16 bit when compact storage is on,
+                          play a fast preview while the file is resampled,
+                          or keep files at their native rate, so the
+                          rate get corrected in the realtime stage,
+                          hold decoded float data planar when planar
+                          storage is on, so the stretcher could read it
+                          in place
                           save a buffer to audio file
 ****************************************************************/
 
@@ -32,32 +56,298 @@ public:
     uint32_t channels;
     uint32_t samplesize;
     uint32_t samplerate;
-    float*   samples;
+    // rate of the data in the buffer
+    uint32_t bufferRate;
+    // the sample data, the filtered data replace the preview while it's
+    // played, so readers load the pointer once and use it from there on
+    std::atomic<float*> samples;
+    // compact storage, used instead of samples for 16 bit files
+    int16_t* samples16;
+    // samples hold one block per channel, channel c start at c * samplesize
+    bool planar;
     float* saveBuffer;
+    std::unique_ptr<DiskStream> stream;
+    bool mapped;
+    // frames decoded so far, playback may start before the file is complete
+    std::atomic<uint32_t> loaded;
+    // peak overview shown in the wave view while the file is decoded
+    std::vector<float> overview;
     
-    AudioFile() {
+    AudioFile() : cache("alooper") {
         channels   = 0;
         samplesize = 0;
         samplerate = 0;
-        samples    = nullptr;
+        bufferRate = 0;
+        samples.store(nullptr, std::memory_order_release);
+        samples16  = nullptr;
+        planar     = false;
         saveBuffer = nullptr;
+        mapped     = false;
+        mapBase    = nullptr;
+        mapSize    = 0;
+        lockFrom   = 0;
+        lockTo     = 0;
+        pending    = nullptr;
+        pendingRate = 0;
+        resampled  = nullptr;
+        retired    = nullptr;
+        segCount   = 0;
+        segLength  = 0;
+        segFrames  = 0;
+        loaded.store(0, std::memory_order_release);
     }
     
     ~AudioFile() {
-        delete[] samples;
+        freeSamples();
         delete[] saveBuffer;
     }
 
+    // check if there is a file loaded or streamed
+    inline bool isLoaded() const noexcept {
+        return samples.load(std::memory_order_acquire) != nullptr || samples16 != nullptr || stream != nullptr;
+    }
+
+    // check if the samples are held in compact storage
+    inline bool isCompact() const noexcept {
+        return samples16 != nullptr;
+    }
+
+    // keep files with 16 bit or less as 16 bit in memory
+    static void setCompactStorage(bool compact) noexcept {
+        compactStorage.store(compact, std::memory_order_release);
+    }
+
+    // hold decoded float files planar in memory
+    static void setPlanarStorage(bool p) noexcept {
+        planarStorage.store(p, std::memory_order_release);
+    }
+
+    // load files at their native rate instead of resampling them
+    static void setNativeRate(bool native) noexcept {
+        nativeRate.store(native, std::memory_order_release);
+    }
+
+    // factor to stretch the playback by, so that the buffer sound
+    // right at the session rate
+    inline double rateCorrection(uint32_t sessionRate) const noexcept {
+        return (bufferRate && sessionRate) ? (double)sessionRate / bufferRate : 1.0;
+    }
+
+    // copy frames (de-interleaved) to planar float buffers, backwards read
+    // pos, pos-1, .. frames not in memory (yet) are filled with silence
+    void readPlanar(uint32_t pos, uint32_t frames, bool backwards,
+                float *const *dest, uint32_t offset, uint32_t chan) const noexcept {
+        if (stream) {
+            // copy span wise up to the next block edge
+            for (uint32_t i = 0; i < frames; ) {
+                const uint32_t p = backwards ? pos - i : pos + i;
+                const uint32_t inBlock = p & (STREAM_BLOCK_FRAMES - 1);
+                const uint32_t n = std::min(frames - i, backwards ? inBlock + 1 : STREAM_BLOCK_FRAMES - inBlock);
+                const float* frame = stream->frame(p);
+                if (frame) {
+                    SampleConvert::planar(frame, channels, 0, n, backwards, dest, offset + i, chan);
+                    stream->release();
+                } else for (uint32_t c = 0; c < chan; c++) std::memset(&dest[c][offset + i], 0, n * sizeof(float));
+                i += n;
+            }
+            return;
+        }
+        // frames above the high-water mark are silent
+        const uint32_t avail = loaded.load(std::memory_order_acquire);
+        uint32_t first = 0;
+        uint32_t count = frames;
+        if (backwards) {
+            first = pos >= avail ? std::min(frames, pos - avail + 1) : 0;
+            count = frames - first;
+        } else {
+            count = pos < avail ? std::min(frames, avail - pos) : 0;
+        }
+        const uint32_t silent = frames - count;
+        if (silent) {
+            const uint32_t from = backwards ? 0 : count;
+            for (uint32_t c = 0; c < chan; c++)
+                std::memset(&dest[c][offset + from], 0, silent * sizeof(float));
+        }
+        if (!count) return;
+        const uint32_t start = backwards ? pos - first : pos;
+        const float* data = samples.load(std::memory_order_acquire);
+        if (planar) SampleConvert::fromPlanes(data, samplesize, start, count, backwards, dest, offset + first, chan);
+        else if (samples16) SampleConvert::planar(samples16, channels, start, count, backwards, dest, offset + first, chan);
+        else if (data) SampleConvert::planar(data, channels, start, count, backwards, dest, offset + first, chan);
+    }
+
+    // point dest to frames of planar storage, so they could be read
+    // in place, return false when the frames aren't all on hand
+    inline bool planarView(uint32_t pos, uint32_t frames, float** dest, uint32_t chan) const noexcept {
+        float* data = samples.load(std::memory_order_acquire);
+        if (!planar || !data || !channels || (uint64_t)pos + frames > loaded.load(std::memory_order_acquire))
+            return false;
+        // a mono file feed all channels
+        for (uint32_t c = 0; c < chan; c++)
+            dest[c] = data + (size_t)std::min(c, channels - 1) * samplesize + pos;
+        return true;
+    }
+
+    // check if enough frames are decoded to start the playback,
+    // loaded count frames at the rate of the buffer, not of the file
+    inline bool canPlay() const noexcept {
+        const uint32_t rate = bufferRate ? bufferRate : samplerate;
+        return stream || loaded.load(std::memory_order_acquire) >=
+            std::min<uint64_t>(samplesize, (uint64_t)rate * PREROLL_SECONDS);
+    }
+
+    // check if the file is still decoded in background
+    inline bool inProgress() const noexcept {
+        return !stream && loaded.load(std::memory_order_acquire) < samplesize;
+    }
+
+    // progress counter for the wave view
+    inline uint32_t waveProgress() const noexcept {
+        if (stream) return stream->overviewDone.load(std::memory_order_acquire);
+        return loaded.load(std::memory_order_acquire);
+    }
+
+    // inform the disk stream about the play-head and the loop points
+    inline void setPlayHead(uint32_t pos, uint32_t l, uint32_t r, bool back) noexcept {
+        if (stream) stream->setPlayHead(pos, l, r, back);
+    }
+
+    // release the sample data, a cache write of it is finished first
+    void freeSamples() {
+        if (cacheWriter.joinable()) cacheWriter.join();
+        if (pending) sf_close(pending);
+        pending = nullptr;
+        loaded.store(0, std::memory_order_release);
+        delete[] resampled;
+        resampled = nullptr;
+        delete[] retired;
+        retired = nullptr;
+        // the pointer is cleared on both ways, so no one see unmapped memory
+        float* data = samples.exchange(nullptr, std::memory_order_acq_rel);
+        #ifdef HAVE_MMAP
+        if (mapped) munmap(mapBase, mapSize);
+        else
+        #endif
+        delete[] data;
+        delete[] samples16;
+        samples16 = nullptr;
+        planar = false;
+        mapped = false;
+        mapBase = nullptr;
+        mapSize = 0;
+        lockFrom = lockTo = 0;
+        stream.reset();
+    }
+
+    // keep the loop region of a mapped file resident in memory,
+    // this may fail silent when RLIMIT_MEMLOCK is to low
+    void lockRegion(uint32_t from, uint32_t to) {
+        #ifdef HAVE_MMAP
+        if (!mapped || (from == lockFrom && to == lockTo)) return;
+        if (lockTo > lockFrom) munlock(pageStart(lockFrom), pageLength(lockFrom, lockTo));
+        lockFrom = lockTo = 0;
+        to = std::min(to, samplesize);
+        if (to <= from || (uint64_t)(to - from) * channels * sizeof(float) > MAX_LOCKED_REGION) return;
+        if (mlock(pageStart(from), pageLength(from, to)) == 0) {
+            lockFrom = from;
+            lockTo = to;
+        }
+        #endif
+    }
+
+    // take over the sample data from a other AudioFile
+    void takeOver(AudioFile& other) {
+        freeSamples();
+        // the other isn't played anymore, so the preview could go
+        delete[] other.retired;
+        other.retired = nullptr;
+        samples.store(other.samples.exchange(nullptr, std::memory_order_acq_rel), std::memory_order_release);
+        // a cache write go on with the data
+        cacheWriter = std::move(other.cacheWriter);
+        samples16 = other.samples16;
+        other.samples16 = nullptr;
+        planar = other.planar;
+        other.planar = false;
+        stream = std::move(other.stream);
+        mapped = other.mapped;
+        mapBase = other.mapBase;
+        mapSize = other.mapSize;
+        other.mapped = false;
+        other.mapBase = nullptr;
+        other.mapSize = 0;
+        lockFrom = other.lockFrom;
+        lockTo = other.lockTo;
+        other.lockFrom = other.lockTo = 0;
+        pending = other.pending;
+        pendingInfo = other.pendingInfo;
+        pendingFile = std::move(other.pendingFile);
+        pendingRate = other.pendingRate;
+        other.pending = nullptr;
+        loaded.store(other.loaded.load(std::memory_order_acquire), std::memory_order_release);
+        other.loaded.store(0, std::memory_order_release);
+        overview.swap(other.overview);
+        channels = other.channels;
+        samplesize = other.samplesize;
+        samplerate = other.samplerate;
+        bufferRate = other.bufferRate;
+        other.channels = 0;
+        other.samplesize = 0;
+        other.samplerate = 0;
+        other.bufferRate = 0;
+    }
+
+    // memory (in bytes) held by the sample data
+    inline uint64_t memoryUsage() const noexcept {
+        if (stream) return (uint64_t)STREAM_BLOCKS * STREAM_BLOCK_FRAMES * channels * sizeof(float);
+        if (samples16) return (uint64_t)samplesize * channels * sizeof(int16_t);
+        return (uint64_t)samplesize * channels * sizeof(float);
+    }
+
+    // memory a file will use once loaded, from its header only,
+    // so a cache could make room before it's decoded, 0 when unknown
+    static uint64_t estimateUsage(const char* file, uint32_t expectedSampleRate) {
+        SF_INFO info;
+        info.format = 0;
+        SNDFILE *sndfile = sf_open(file, SFM_READ, &info);
+        if (!sndfile) return 0;
+        sf_close(sndfile);
+        if (info.channels < 1 || info.samplerate < 1) return 0;
+        if (nativeRate.load(std::memory_order_acquire)) expectedSampleRate = info.samplerate;
+        const bool resample = info.samplerate != (int)expectedSampleRate;
+        const uint64_t bytes = (uint64_t)info.frames * info.channels * sizeof(float);
+        if (!resample && info.seekable && bytes > STREAM_THRESHOLD)
+            return (uint64_t)STREAM_BLOCKS * STREAM_BLOCK_FRAMES * info.channels * sizeof(float);
+        if (resample) return (uint64_t)std::ceil((double)bytes * expectedSampleRate / info.samplerate);
+        const int sub = info.format & SF_FORMAT_SUBMASK;
+        if (compactStorage.load(std::memory_order_acquire) &&
+                (sub == SF_FORMAT_PCM_16 || sub == SF_FORMAT_PCM_S8 || sub == SF_FORMAT_PCM_U8))
+            return bytes / 2;
+        return bytes;
+    }
+
     // load a Audio File into the buffer
     inline bool getAudioFile(const char* file, uint32_t expectedSampleRate) {
+        if (!openAudioFile(file, expectedSampleRate, false)) return false;
+        finishAudioFile();
+        return true;
+    }
+
+    // open a Audio File, files which need no resampling are only
+    // prepared here and decoded afterwards by finishAudioFile(),
+    // with preview set a resampled file is played first from a fast
+    // linear conversion until the filtered one is done
+    inline bool openAudioFile(const char* file, uint32_t expectedSampleRate, bool preview) {
         SF_INFO info;
         info.format = 0;
 
         channels = 0;
         samplesize = 0;
         samplerate = 0;
-        delete[] samples;
-        samples = nullptr;
+        bufferRate = expectedSampleRate;
+        freeSamples();
+        const bool native = nativeRate.load(std::memory_order_acquire);
+        // a file decoded or resampled before is mapped from the cache
+        if (!native && loadCachedFile(file, expectedSampleRate)) return true;
         // Open the wave file for reading
         SNDFILE *sndfile = sf_open(file, SFM_READ, &info);
 
@@ -69,20 +359,139 @@ public:
             std::cerr << "Error: only two channels maximum are supported!" << std::endl;
             return false;
         }
+        // the file is loaded as it is, the realtime stage correct the rate
+        if (native) {
+            bufferRate = expectedSampleRate = info.samplerate;
+            if (loadCachedFile(file, expectedSampleRate)) {
+                sf_close(sndfile);
+                return true;
+            }
+        }
+        // map float wave files at session rate directly into memory
+        if (mapAudioFile(file, info, expectedSampleRate)) {
+            sf_close(sndfile);
+            loaded.store(samplesize, std::memory_order_release);
+            return true;
+        }
+        // stream large files from disk when no resampling is needed
+        if (info.seekable && (info.samplerate == (int)expectedSampleRate) &&
+                ((uint64_t)info.frames * info.channels * sizeof(float) > STREAM_THRESHOLD)) {
+            sf_close(sndfile);
+            stream = std::make_unique<DiskStream>();
+            if (!stream->open(file, info)) {
+                stream.reset();
+                return false;
+            }
+            channels = stream->channels;
+            samplesize = stream->samplesize;
+            samplerate = info.samplerate;
+            loaded.store(samplesize, std::memory_order_release);
+            return true;
+        }
+        // 16 bit files at session rate could be stored without loss as 16 bit
+        const int sub = info.format & SF_FORMAT_SUBMASK;
+        const bool resample = info.samplerate != (int)expectedSampleRate;
+        const bool compact = compactStorage.load(std::memory_order_acquire) && !resample &&
+            (sub == SF_FORMAT_PCM_16 || sub == SF_FORMAT_PCM_S8 || sub == SF_FORMAT_PCM_U8);
+        channels = info.channels;
+        samplerate = info.samplerate;
+        planar = planarStorage.load(std::memory_order_acquire) && !compact;
         try {
-            samples = new float[info.frames * info.channels];
+            if (resample) {
+                // the resampler write directly into the final buffer
+                uint32_t olen = 0;
+                float* filtered = beginResample(info.samplerate, info.frames, channels,
+                                                expectedSampleRate, &olen, 32, planar);
+                samplesize = olen;
+                if (filtered && preview && info.seekable) {
+                    resampled = filtered;
+                    samples.store(new float[(size_t)olen * channels], std::memory_order_release);
+                } else {
+                    samples.store(filtered, std::memory_order_release);
+                }
+            } else {
+                if (compact) samples16 = new int16_t[info.frames * info.channels];
+                else samples.store(new float[info.frames * info.channels], std::memory_order_release);
+                samplesize = info.frames;
+            }
         } catch (...) {
+            samples.store(nullptr, std::memory_order_release);
+        }
+        if (!samples.load(std::memory_order_acquire) && !samples16) {
             std::cerr << "Error: could not load file" << std::endl;
+            sf_close(sndfile);
+            freeSamples();
             return false;
         }
-        std::memset(samples, 0, info.frames * info.channels * sizeof(float));
-        samplesize = (uint32_t) sf_readf_float(sndfile, &samples[0], info.frames);
-        if (!samplesize ) samplesize = info.frames;
-        channels = info.channels;
-        samplerate = info.samplerate;
-        sf_close(sndfile);
-        samples = checkSampleRate(&samplesize, channels, samples, samplerate, expectedSampleRate);
-        return samples ? true : false;
+        // decode (and resample) progressive in finishAudioFile()
+        overview.assign((size_t)STREAM_OVERVIEW_FRAMES * channels, 0.0f);
+        pending = sndfile;
+        pendingInfo = info;
+        pendingFile = file;
+        pendingRate = expectedSampleRate;
+        return true;
+    }
+
+    // decode a opened file, the loaded frames could be played meanwhile
+    void finishAudioFile() {
+        if (!pending) return;
+        const SF_INFO& info = pendingInfo;
+        const bool resample = info.samplerate != (int)pendingRate;
+        // play the preview while the filtered data is computed
+        if (resample && resampled) {
+            if (readPreview(pending)) {
+                finishPreview(info);
+            } else {
+                // the file couldn't be rewound, the preview stay
+                closeResample();
+                delete[] resampled;
+                resampled = nullptr;
+                sf_close(pending);
+                pending = nullptr;
+                loaded.store(samplesize, std::memory_order_release);
+            }
+            return;
+        }
+        uint32_t count = resample ? readResampledSegmented(pendingFile.c_str(), pending, info) :
+                                    readSegmented(pendingFile.c_str(), pending, info, true);
+        float* data = samples.load(std::memory_order_acquire);
+        // clear only what the decoder didn't fill
+        if (samples16) std::memset(&samples16[count * info.channels], 0,
+            (samplesize - count) * info.channels * sizeof(int16_t));
+        else clearFrom(data, count);
+        sf_close(pending);
+        pending = nullptr;
+        loaded.store(samplesize, std::memory_order_release);
+        // resampled data and compressed formats are worth to be cached
+        const int major = info.format & SF_FORMAT_TYPEMASK;
+        if (data && count && (resample || (count == samplesize &&
+                (major == SF_FORMAT_FLAC || major == SF_FORMAT_OGG || major == SF_FORMAT_MPEG))))
+            storeCache(data);
+    }
+
+    // resample the file a second time with the filter into its own buffer,
+    // then swap it in for the preview, the readers which loaded the preview
+    // before keep it, it stay until the samples are freed
+    void finishPreview(const SF_INFO& info) {
+        float* filtered = resampled;
+        uint32_t count = readResampledSegmented(pendingFile.c_str(), pending, info);
+        clearFrom(filtered, count);
+        sf_close(pending);
+        pending = nullptr;
+        resampled = nullptr;
+        retired = samples.exchange(filtered, std::memory_order_acq_rel);
+        if (count) storeCache(filtered);
+    }
+
+    // write the decoded data to the disk cache in background, so the
+    // playback and the next load didn't wait for it, the thread go with
+    // the data in takeOver() and is joined before the data is freed
+    void storeCache(const float* data) {
+        if (cacheWriter.joinable()) cacheWriter.join();
+        cacheWriter = std::thread([data, file = pendingFile, rate = pendingRate, chan = channels,
+                                   frames = samplesize, sr = samplerate, p = planar] () {
+            SampleCache("alooper").store(file.c_str(), rate, data, chan, frames, sr, p);
+        });
     }
 
     // save a audio file from buffer to file
@@ -96,7 +505,23 @@ public:
             std::cerr << "fail to open " << name << std::endl;
             return;
         }
-        sf_writef_float(sf,&samples[from], to - from);
+        const float* data = samples.load(std::memory_order_acquire);
+        if (samples16) {
+            sf_writef_short(sf,&samples16[from * channels], to - from);
+        } else if (planar) {
+            // interleave chunk wise
+            std::vector<float> chunk((size_t)PROGRESS_FRAMES * channels);
+            for (uint32_t i = from; i < to; ) {
+                const uint32_t n = std::min<uint32_t>(to - i, PROGRESS_FRAMES);
+                for (uint32_t c = 0; c < channels; c++)
+                    for (uint32_t k = 0; k < n; k++)
+                        chunk[(size_t)k * channels + c] = data[(size_t)c * samplesize + i + k];
+                sf_writef_float(sf, chunk.data(), n);
+                i += n;
+            }
+        } else {
+            sf_writef_float(sf,&data[from * channels], to - from);
+        }
         sf_write_sync(sf);
         sf_close(sf);
     }
@@ -117,6 +542,384 @@ public:
         sf_close(sf);
     }
 
+private:
+    void*    mapBase;
+    size_t   mapSize;
+    uint32_t lockFrom;
+    uint32_t lockTo;
+
+    // largest loop region (in bytes) locked into memory
+    static constexpr uint64_t MAX_LOCKED_REGION = 256 * 1024 * 1024;
+    // min frames per segment when decoding in parallel
+    static constexpr sf_count_t MIN_SEGMENT_FRAMES = 1 << 20;
+    // frames decoded before the progress is published
+    static constexpr sf_count_t PROGRESS_FRAMES = 1 << 16;
+    // seconds decoded before the playback starts
+    static constexpr uint32_t PREROLL_SECONDS = 2;
+
+    static inline std::atomic<bool> compactStorage{false};
+    static inline std::atomic<bool> nativeRate{false};
+    static inline std::atomic<bool> planarStorage{false};
+    SampleCache cache;
+    // write the decoded data to the cache
+    std::thread cacheWriter;
+    SNDFILE* pending;
+    SF_INFO pendingInfo;
+    std::string pendingFile;
+    uint32_t pendingRate;
+    // the filtered data while the preview is decoded
+    float* resampled;
+    // the preview after the filtered data was swapped in
+    float* retired;
+    std::unique_ptr<std::atomic<sf_count_t>[]> segDone;
+    sf_count_t segCount;
+    sf_count_t segLength;
+    sf_count_t segFrames;
+
+    // decode a frame range with its own file handle into its slice of the buffer
+    sf_count_t readSegment(const char* file, sf_count_t start, sf_count_t frames,
+                            std::atomic<sf_count_t>* count, bool publish) {
+        SF_INFO info;
+        info.format = 0;
+        SNDFILE *sndfile = sf_open(file, SFM_READ, &info);
+        if (!sndfile) return 0;
+        if (sf_seek(sndfile, start, SEEK_SET) == start)
+            readChunked(sndfile, start, frames, count, publish);
+        sf_close(sndfile);
+        return count->load(std::memory_order_acquire);
+    }
+
+    // decode in chunks, so that the progress could be published
+    void readChunked(SNDFILE *sndfile, sf_count_t start, sf_count_t frames,
+                            std::atomic<sf_count_t>* count, bool publish) {
+        std::vector<float> chunk;
+        float* data = samples.load(std::memory_order_acquire);
+        while (count->load(std::memory_order_relaxed) < frames) {
+            sf_count_t done = count->load(std::memory_order_relaxed);
+            const sf_count_t want = std::min(PROGRESS_FRAMES, frames - done);
+            sf_count_t n = 0;
+            if (samples16) {
+                int16_t* buffer = &samples16[(start + done) * channels];
+                n = sf_readf_short(sndfile, buffer, want);
+                if (n > 0 && publish)
+                    DiskStream::addPeaks(overview, channels, samplesize, start + done, buffer, n, SAMPLE_SCALE_16);
+            } else if (planar) {
+                // decode into a chunk and split it into the channel blocks
+                chunk.resize((size_t)want * channels);
+                n = sf_readf_float(sndfile, chunk.data(), want);
+                if (n > 0) {
+                    float* dest[2];
+                    for (uint32_t c = 0; c < channels; c++) dest[c] = data + (size_t)c * samplesize;
+                    SampleConvert::planar(chunk.data(), channels, 0, n, false, dest, start + done, channels);
+                    if (publish)
+                        DiskStream::addPeaks(overview, channels, samplesize, start + done, chunk.data(), n);
+                }
+            } else {
+                float* buffer = &data[(start + done) * channels];
+                n = sf_readf_float(sndfile, buffer, want);
+                if (n > 0 && publish)
+                    DiskStream::addPeaks(overview, channels, samplesize, start + done, buffer, n);
+            }
+            if (n <= 0) break;
+            count->store(done + n, std::memory_order_release);
+            if (publish) publishLoaded();
+        }
+    }
+
+    // decode a chunk into a scratch buffer and resample it into the final
+    // buffer, so the whole file is never held twice in memory
+    uint32_t readResampled(SNDFILE *sndfile) {
+        float* out = resampleBuffer();
+        std::vector<float> scratch((size_t)PROGRESS_FRAMES * channels);
+        uint32_t done = 0;
+        sf_count_t n;
+        while ((n = sf_readf_float(sndfile, scratch.data(), PROGRESS_FRAMES)) > 0) {
+            uint32_t count = feedResample(scratch.data(), (uint32_t)n);
+            addBufferPeaks(out, done, count - done);
+            done = count;
+            raiseLoaded(done);
+        }
+        uint32_t count = endResample();
+        addBufferPeaks(out, done, count - done);
+        return count;
+    }
+
+    // resample segments of the file in parallel, each worker decode its
+    // segment with its own handle, starting the history frames before it,
+    // the segments start at multiples of the input ratio step, so their
+    // output join at exact frames, return the number of frames in a row
+    uint32_t readResampledSegmented(const char* file, SNDFILE *sndfile, const SF_INFO& info) {
+        const int major = info.format & SF_FORMAT_TYPEMASK;
+        const sf_count_t a = ratioIn();
+        const sf_count_t history = segmentHistory();
+        sf_count_t segments = std::min<sf_count_t>(std::thread::hardware_concurrency(),
+                                                    info.frames / MIN_SEGMENT_FRAMES);
+        // input frames per segment, rounded up to the ratio step
+        sf_count_t inLength = segments > 1 ?
+                ((info.frames + segments - 1) / segments + a - 1) / a * a : info.frames;
+        if (segments > 1) segments = (info.frames + inLength - 1) / inLength;
+        // mp3 seeking isn't sample exact
+        if (!info.seekable || segments < 2 || major == SF_FORMAT_MPEG)
+            return readResampled(sndfile);
+
+        // the progress is counted in output frames
+        segFrames = samplesize;
+        segLength = inLength / a * ratioOut();
+        segCount = segments;
+        segDone.reset(new std::atomic<sf_count_t>[segments]);
+        for (sf_count_t i = 0; i < segments; i++) segDone[i].store(0, std::memory_order_relaxed);
+        float* out = resampleBuffer();
+        auto run = [this, segments, inLength, out] (SNDFILE *handle, sf_count_t i) {
+            const sf_count_t outFrom = i * segLength;
+            const uint32_t outFrames = (uint32_t) std::min(segLength, segFrames - outFrom);
+            resampleSegment(i * inLength, outFrames, i == segments - 1, PROGRESS_FRAMES,
+                [handle] (float* buffer, uint32_t frames) {
+                    sf_count_t n = sf_readf_float(handle, buffer, frames);
+                    return n > 0 ? (uint32_t)n : 0;
+                },
+                [this, i, outFrom, out] (uint32_t done) {
+                    sf_count_t old = segDone[i].load(std::memory_order_relaxed);
+                    addBufferPeaks(out, outFrom + old, (uint32_t)(done - old));
+                    segDone[i].store(done, std::memory_order_release);
+                    publishLoaded();
+                });
+        };
+        std::vector<std::thread> workers;
+        for (sf_count_t i = 1; i < segments; i++) {
+            workers.emplace_back([this, file, i, inLength, history, &run] () {
+                SF_INFO sinfo;
+                sinfo.format = 0;
+                SNDFILE *handle = sf_open(file, SFM_READ, &sinfo);
+                if (!handle) return;
+                const sf_count_t start = i * inLength - history;
+                if (sf_seek(handle, start, SEEK_SET) == start) run(handle, i);
+                sf_close(handle);
+            });
+        }
+        // the first segment is read with the already open handle
+        run(sndfile, 0);
+        for (auto& t : workers) t.join();
+        closeResample();
+        // only the frames resampled without a gap count
+        sf_count_t read = 0;
+        for (sf_count_t i = 0; i < segments; i++) {
+            sf_count_t c = segDone[i].load(std::memory_order_acquire);
+            read += c;
+            if (c != std::min(segLength, segFrames - i * segLength)) break;
+        }
+        segCount = 0;
+        segDone.reset();
+        return (uint32_t) read;
+    }
+
+    // add the peaks of frames in a buffer of the storage layout to the overview
+    void addBufferPeaks(const float* buffer, uint64_t from, uint32_t frames) {
+        if (!planar) {
+            DiskStream::addPeaks(overview, channels, samplesize, from, &buffer[from * channels], frames);
+            return;
+        }
+        for (uint32_t c = 0; c < channels; c++) {
+            const float* b = &buffer[(size_t)c * samplesize + from];
+            for (uint32_t i = 0; i < frames; i++) {
+                uint32_t o = (uint32_t)(((from + i) * STREAM_OVERVIEW_FRAMES) / samplesize);
+                DiskStream::raisePeak(overview[o * channels + c], std::fabs(b[i]));
+            }
+        }
+    }
+
+    // clear a float buffer of the storage layout from frame on
+    void clearFrom(float* buffer, uint32_t frame) {
+        if (!planar) {
+            std::memset(&buffer[(size_t)frame * channels], 0, (size_t)(samplesize - frame) * channels * sizeof(float));
+            return;
+        }
+        for (uint32_t c = 0; c < channels; c++)
+            std::memset(&buffer[(size_t)c * samplesize + frame], 0, (size_t)(samplesize - frame) * sizeof(float));
+    }
+
+    // move the high-water mark to the end of the frames decoded in a row
+    void publishLoaded() {
+        sf_count_t read = 0;
+        for (sf_count_t i = 0; i < segCount; i++) {
+            sf_count_t c = segDone[i].load(std::memory_order_acquire);
+            read += c;
+            if (c != std::min(segLength, segFrames - i * segLength)) break;
+        }
+        raiseLoaded((uint32_t) read);
+    }
+
+    // move the high-water mark forward, it never goes back while a file
+    // is resampled the second time behind its preview
+    void raiseLoaded(uint32_t mark) {
+        uint32_t old = loaded.load(std::memory_order_relaxed);
+        while (old < mark && !loaded.compare_exchange_weak(old, mark, std::memory_order_release));
+    }
+
+    // decode the file and convert it with linear interpolation into the
+    // preview buffer, rewind the file for the filtered pass afterwards
+    bool readPreview(SNDFILE *sndfile) {
+        float* preview = samples.load(std::memory_order_acquire);
+        uint32_t count = previewResample(preview, samplesize, PROGRESS_FRAMES,
+            [sndfile] (float* buffer, uint32_t frames) {
+                sf_count_t n = sf_readf_float(sndfile, buffer, frames);
+                return n > 0 ? (uint32_t)n : 0;
+            },
+            [this, preview] (uint32_t done) {
+                uint32_t old = loaded.load(std::memory_order_relaxed);
+                if (done > old) addBufferPeaks(preview, old, done - old);
+                raiseLoaded(done);
+            });
+        loaded.store(count, std::memory_order_release);
+        return sf_seek(sndfile, 0, SEEK_SET) == 0;
+    }
+
+    // decode the file into the buffer, compressed files get split in segments
+    // which are decoded in parallel, return the number of frames read in a row
+    uint32_t readSegmented(const char* file, SNDFILE *sndfile, const SF_INFO& info, bool publish) {
+        const int major = info.format & SF_FORMAT_TYPEMASK;
+        sf_count_t segments = std::min<sf_count_t>(std::thread::hardware_concurrency(),
+                                                    info.frames / MIN_SEGMENT_FRAMES);
+        if (!info.seekable || segments < 2 || (major != SF_FORMAT_FLAC && major != SF_FORMAT_OGG))
+            segments = 1;
+
+        segFrames = info.frames;
+        segLength = (info.frames + segments - 1) / segments;
+        segCount = segments;
+        segDone.reset(new std::atomic<sf_count_t>[segments]);
+        for (sf_count_t i = 0; i < segments; i++) segDone[i].store(0, std::memory_order_relaxed);
+        std::vector<std::thread> workers;
+        for (sf_count_t i = 1; i < segments; i++) {
+            sf_count_t start = i * segLength;
+            sf_count_t frames = std::min(segLength, info.frames - start);
+            workers.emplace_back([this, file, start, frames, i, publish] () {
+                readSegment(file, start, frames, &segDone[i], publish);
+            });
+        }
+        // the first segment is read with the already open handle
+        readChunked(sndfile, 0, std::min(segLength, info.frames), &segDone[0], publish);
+        for (auto& t : workers) t.join();
+        // only the frames read without a gap count
+        sf_count_t read = 0;
+        for (sf_count_t i = 0; i < segments; i++) {
+            sf_count_t c = segDone[i].load(std::memory_order_acquire);
+            read += c;
+            if (c != std::min(segLength, info.frames - i * segLength)) break;
+        }
+        segCount = 0;
+        segDone.reset();
+        return (uint32_t) read;
+    }
+
+    // map a cache entry of the file, when there is one
+    bool loadCachedFile(const char* file, uint32_t expectedSampleRate) {
+        SampleCache::Entry entry;
+        if (!cache.load(file, expectedSampleRate, &entry)) return false;
+        samples.store(entry.samples, std::memory_order_release);
+        mapBase = entry.base;
+        mapSize = entry.size;
+        mapped = entry.mapped;
+        channels = entry.channels;
+        samplesize = entry.frames;
+        samplerate = entry.samplerate;
+        loaded.store(samplesize, std::memory_order_release);
+        return true;
+    }
+
+    #ifdef HAVE_MMAP
+    // page aligned start address of a frame in the mapped file
+    inline void* pageStart(uint32_t frame) const {
+        uintptr_t page = (uintptr_t) sysconf(_SC_PAGESIZE);
+        uintptr_t p = (uintptr_t) &samples.load(std::memory_order_acquire)[(size_t)frame * channels];
+        return (void*)(p & ~(page - 1));
+    }
+
+    // length of a frame range, counted from the page aligned start
+    inline size_t pageLength(uint32_t from, uint32_t to) const {
+        uintptr_t p = (uintptr_t) &samples.load(std::memory_order_acquire)[(size_t)to * channels];
+        return p - (uintptr_t) pageStart(from);
+    }
+
+    static inline uint32_t readLE32(const unsigned char* p) {
+        return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    }
+
+    static inline uint16_t readLE16(const unsigned char* p) {
+        return p[0] | (p[1] << 8);
+    }
+
+    // find the data chunk of a RIFF/WAVE file holding 32 bit float samples
+    static bool findFloatData(int fd, uint32_t chan, off_t* offset, uint64_t* length) {
+        unsigned char head[12];
+        if (pread(fd, head, 12, 0) != 12) return false;
+        if (std::memcmp(head, "RIFF", 4) != 0 || std::memcmp(head + 8, "WAVE", 4) != 0) return false;
+        bool isFloat = false;
+        off_t pos = 12;
+        unsigned char chunk[8];
+        while (pread(fd, chunk, 8, pos) == 8) {
+            uint32_t size = readLE32(chunk + 4);
+            if (std::memcmp(chunk, "fmt ", 4) == 0) {
+                unsigned char fmt[26];
+                ssize_t n = pread(fd, fmt, std::min<uint32_t>(size, 26), pos + 8);
+                if (n < 16) return false;
+                uint16_t tag = readLE16(fmt);
+                // WAVE_FORMAT_EXTENSIBLE carries the format tag in the sub format GUID
+                if (tag == 0xFFFE && n >= 26) tag = readLE16(fmt + 24);
+                isFloat = (tag == 3) && (readLE16(fmt + 2) == chan) && (readLE16(fmt + 14) == 32);
+            } else if (std::memcmp(chunk, "data", 4) == 0) {
+                *offset = pos + 8;
+                *length = size;
+                return isFloat;
+            }
+            pos += 8 + size + (size & 1);
+        }
+        return false;
+    }
+    #endif
+
+    // map the sample data of a float wave file at session rate into memory
+    bool mapAudioFile(const char* file, const SF_INFO& info, uint32_t expectedSampleRate) {
+        #if defined(HAVE_MMAP) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+        if ((info.samplerate != (int)expectedSampleRate) ||
+            ((info.format & SF_FORMAT_SUBMASK) != SF_FORMAT_FLOAT) ||
+            ((info.format & SF_FORMAT_TYPEMASK) != SF_FORMAT_WAV)) return false;
+        int fd = open(file, O_RDONLY);
+        if (fd < 0) return false;
+        off_t offset = 0;
+        uint64_t length = 0;
+        struct stat st;
+        if (!findFloatData(fd, info.channels, &offset, &length) || (offset % sizeof(float)) ||
+                fstat(fd, &st) != 0 || st.st_size <= offset) {
+            close(fd);
+            return false;
+        }
+        // never map behind the end of the file
+        length = std::min<uint64_t>(length, st.st_size - offset);
+        size_t size = offset + length;
+        void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) return false;
+        // ask the kernel to read ahead
+        posix_madvise(base, size, POSIX_MADV_WILLNEED);
+        mapBase = base;
+        mapSize = size;
+        mapped = true;
+        samples.store((float*)((char*)base + offset), std::memory_order_release);
+        channels = info.channels;
+        samplesize = (uint32_t) std::min<uint64_t>(length / (sizeof(float) * channels), info.frames);
+        samplerate = info.samplerate;
+        if (!samplesize) {
+            freeSamples();
+            return false;
+        }
+        return true;
+        #else
+        (void) file;
+        (void) info;
+        (void) expectedSampleRate;
+        return false;
+        #endif
+    }
+
 };
 
 #endif
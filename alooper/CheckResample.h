@@ -10,8 +10,11 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <assert.h>
+#include <algorithm>
 #include <cmath>
 #include <cstring>
+#include <cstdio>
+#include <vector>
 #include <zita-resampler/resampler.h>
 
 
@@ -20,16 +23,199 @@
 #ifndef CHECKRESAMPLE_H
 #define CHECKRESAMPLE_H
 
+/****************************************************************
+        class CheckResample - resample a file chunk wise while it
+                              is decoded, the output is written
+                              directly into the final buffer,
+                              segments of the input could be
+                              resampled in parallel, each with its
+                              own Resampler, the output could be
+                              interleaved or planar (one block
+                              per channel)
+****************************************************************/
+
+// frames per scratch chunk when the output is planar
+#define RESAMPLE_PLANAR_CHUNK 4096
+
 class CheckResample : Resampler{
 public:
-    CheckResample() {}
+    CheckResample() : stream_out(nullptr), stream_left(0), stream_done(0), stream_chan(0),
+        stream_frames(0), stream_planar(false), stream_inp(0), stream_outp(0),
+        stream_qual(0), ratio_a(1), ratio_b(1) {}
 
-    float *checkSampleRate(uint32_t *count, uint32_t chan, float *impresp,
-                            uint32_t imprate, uint32_t samplerate) {
-        if (imprate != samplerate) {
-            return process(imprate, *count, impresp, chan, samplerate, count, 32);
+    // start a chunk wise conversion, return the output buffer sized
+    // for all output frames, or nullptr when the rates are not supported,
+    // a planar output hold channel c at c * olen
+    float *beginResample(int32_t fs_inp, uint32_t ilen, uint32_t chan,
+                            int32_t fs_outp, uint32_t *olen, const int32_t qual,
+                            bool planar = false) {
+        uint32_t d = gcd(fs_inp, fs_outp);
+        ratio_a = fs_inp / d;
+        ratio_b = fs_outp / d;
+
+        clear();
+        if (setup(fs_inp, fs_outp, chan, qual) != 0) {
+            return nullptr;
+        }
+        // pre-fill with k/2-1 zeros
+        int32_t k = inpsize();
+        inp_count = k/2-1;
+        inp_data = 0;
+        out_count = 1; // must be at least 1 to get going
+        out_data = 0;
+        if (Resampler::process() != 0) {
+            return nullptr;
         }
-        return impresp;
+        *olen = (uint32_t)(((uint64_t)ilen * ratio_b + ratio_a - 1) / ratio_a);
+        float *p = new float[(size_t)*olen * chan];
+        stream_out = p;
+        stream_left = *olen;
+        stream_done = 0;
+        stream_chan = chan;
+        stream_frames = *olen;
+        stream_planar = planar;
+        if (planar) stream_scratch.resize((size_t)RESAMPLE_PLANAR_CHUNK * chan);
+        stream_inp = fs_inp;
+        stream_outp = fs_outp;
+        stream_qual = qual;
+        return p;
+    }
+
+    // input frames per ratio step, a segment must start at a multiple of it
+    inline uint32_t ratioIn() const noexcept {
+        return ratio_a;
+    }
+
+    // output frames per ratio step
+    inline uint32_t ratioOut() const noexcept {
+        return ratio_b;
+    }
+
+    // input frames before a segment start, which prime the filter
+    inline uint32_t segmentHistory() {
+        return inpsize()/2-1;
+    }
+
+    // resample the segment of the input starting at frame start (a multiple
+    // of ratioIn()) with its own Resampler into outFrames of the output buffer.
+    // read(buffer, frames) deliver the input from start - segmentHistory() on,
+    // so the filter is primed with the real input instead of zeros and the
+    // output match the one of a single run over the whole input exactly.
+    // progress(done) get the number of output frames written so far.
+    template <typename Reader, typename Progress>
+    uint32_t resampleSegment(uint64_t start, uint32_t outFrames, bool last,
+                                uint32_t chunk, Reader read, Progress progress) {
+        if (!stream_out) return 0;
+        Resampler r;
+        if (r.setup(stream_inp, stream_outp, stream_chan, stream_qual) != 0) return 0;
+        const uint32_t history = r.inpsize()/2-1;
+        std::vector<float> buffer((size_t)std::max(chunk, history) * stream_chan);
+        std::vector<float> scratch(stream_planar ? (size_t)RESAMPLE_PLANAR_CHUNK * stream_chan : 0);
+        const size_t out = (size_t)(start / ratio_a * ratio_b);
+        uint32_t done = 0;
+        r.inp_count = history;
+        r.inp_data = 0;
+        r.out_count = 1;
+        r.out_data = 0;
+        if (start) {
+            if (read(buffer.data(), history) != history) return 0;
+            r.inp_data = buffer.data();
+        }
+        if (r.process() != 0) return 0;
+        while (done < outFrames) {
+            uint32_t n = read(buffer.data(), chunk);
+            if (!n) break;
+            r.inp_count = n;
+            r.inp_data = buffer.data();
+            done += writeOut(r, scratch.data(), out + done, outFrames - done);
+            progress(done);
+        }
+        // the last segment get flushed with k/2 zeros like endResample()
+        if (last && done < outFrames) {
+            r.inp_count = history + 1;
+            r.inp_data = 0;
+            done += writeOut(r, scratch.data(), out + done, outFrames - done);
+            progress(done);
+        }
+        return done;
+    }
+
+    // release the output buffer after the segments got resampled
+    inline void closeResample() {
+        stream_out = nullptr;
+    }
+
+    // check if the output is planar
+    inline bool planarOutput() const noexcept {
+        return stream_planar;
+    }
+
+    // the output buffer of the running conversion
+    inline float *resampleBuffer() const noexcept {
+        return stream_out;
+    }
+
+    // cheap linear interpolation of the whole input into out, used as a
+    // preview while the filtered conversion is running, the output frames
+    // are aligned in time with the ones of the filter
+    template <typename Reader, typename Progress>
+    uint32_t previewResample(float *out, uint32_t outFrames, uint32_t chunk,
+                                Reader read, Progress progress) {
+        const uint32_t chan = stream_chan;
+        // buffer[0] hold the last frame of the previous chunk
+        std::vector<float> buffer((size_t)(chunk + 1) * chan, 0.0f);
+        uint64_t base = 0;
+        uint32_t avail = read(buffer.data(), chunk);
+        bool end = !avail;
+        uint32_t done = 0;
+        while (done < outFrames) {
+            const uint64_t p = (uint64_t)done * ratio_a;
+            const uint64_t i = p / ratio_b;
+            if (!end && i + 1 >= base + avail) {
+                if (avail) {
+                    std::memmove(buffer.data(), &buffer[(size_t)(avail - 1) * chan], chan * sizeof(float));
+                    base += avail - 1;
+                }
+                uint32_t n = read(&buffer[chan], chunk);
+                end = !n;
+                avail = 1 + n;
+                progress(done);
+                continue;
+            }
+            const float f = (float)(p - i * ratio_b) / (float)ratio_b;
+            const float *s0 = i < base + avail ? &buffer[(size_t)(i - base) * chan] : nullptr;
+            const float *s1 = i + 1 < base + avail ? &buffer[(size_t)(i + 1 - base) * chan] : nullptr;
+            for (uint32_t c = 0; c < chan; c++) {
+                const float a = s0 ? s0[c] : 0.0f;
+                const float b = s1 ? s1[c] : 0.0f;
+                out[stream_planar ? (size_t)c * outFrames + done : (size_t)done * chan + c] = a + f * (b - a);
+            }
+            done++;
+        }
+        progress(done);
+        return done;
+    }
+
+    // resample a chunk of input frames into the output buffer,
+    // return the number of output frames written so far
+    uint32_t feedResample(float *input, uint32_t frames) {
+        inp_count = frames;
+        inp_data = input;
+        push();
+        return stream_done;
+    }
+
+    // flush the filter with k/2 zeros, return the number of output frames
+    uint32_t endResample() {
+        inp_data = 0;
+        inp_count = inpsize()/2;
+        push();
+        #ifndef NDEBUG
+        if (inp_count)
+            printf("resampled, lost %i samples\n", inp_count);
+        #endif
+        stream_out = nullptr;
+        return stream_done;
     }
 
     ~CheckResample() {
@@ -37,6 +223,52 @@ public:
     }
 
 private:
+    float *stream_out;
+    uint32_t stream_left;
+    uint32_t stream_done;
+    uint32_t stream_chan;
+    uint32_t stream_frames;
+    bool     stream_planar;
+    std::vector<float> stream_scratch;
+    uint32_t stream_inp;
+    uint32_t stream_outp;
+    int32_t  stream_qual;
+    uint32_t ratio_a;
+    uint32_t ratio_b;
+
+    // run the resampler into the free part of the output buffer
+    void push() {
+        if (!stream_left) return;
+        const uint32_t n = writeOut(*this, stream_scratch.data(), stream_done, stream_left);
+        stream_done += n;
+        stream_left -= n;
+    }
+
+    // run a resampler into the output buffer from frame at on, a planar
+    // output is written through the interleaved scratch chunk,
+    // return the number of frames written
+    uint32_t writeOut(Resampler& r, float *scratch, size_t at, uint32_t frames) {
+        if (!stream_planar) {
+            r.out_count = frames;
+            r.out_data = stream_out + at * stream_chan;
+            r.process();
+            return frames - r.out_count;
+        }
+        uint32_t done = 0;
+        do {
+            const uint32_t n = std::min<uint32_t>(frames - done, RESAMPLE_PLANAR_CHUNK);
+            r.out_count = n;
+            r.out_data = scratch;
+            r.process();
+            const uint32_t got = n - r.out_count;
+            for (uint32_t c = 0; c < stream_chan; c++) {
+                float *d = stream_out + (size_t)c * stream_frames + at + done;
+                for (uint32_t i = 0; i < got; i++) d[i] = scratch[(size_t)i * stream_chan + c];
+            }
+            done += got;
+        } while (r.inp_count && done < frames);
+        return done;
+    }
 
     static uint32_t gcd (uint32_t a, uint32_t b) {
         if (a == 0) return b;
@@ -54,51 +286,6 @@ private:
         }
         return 1;
     }
-
-    float* process(int32_t fs_inp, int32_t ilen, float *input, uint32_t chan, 
-                    int32_t fs_outp, uint32_t *olen, const int32_t qual){
-        uint32_t d = gcd(fs_inp, fs_outp);
-        uint32_t ratio_a = fs_inp / d;
-        uint32_t ratio_b = fs_outp / d;
-
-        clear();
-        if (setup(fs_inp, fs_outp, chan, qual) != 0) {
-            return 0;
-        }
-        // pre-fill with k/2-1 zeros
-        int32_t k = inpsize();
-        inp_count = k/2-1;
-        inp_data = 0;
-        out_count = 1; // must be at least 1 to get going
-        out_data = 0;
-        if (Resampler::process() != 0) {
-            return 0;
-        }
-        inp_count = ilen;
-        uint32_t nout = out_count = (ilen * ratio_b + ratio_a - 1) / ratio_a;
-        inp_data = input;
-        float *p = out_data = new float[out_count*chan];
-        if (Resampler::process() != 0) {
-            delete[] p;
-            return 0;
-        }
-        inp_data = 0;
-        inp_count = k/2;
-        if (Resampler::process() != 0) {
-            delete[] p;
-            return 0;
-        }
-       // assert(inp_count == 0);
-       // assert(out_count <= 1);
-        *olen = nout - out_count;
-        #ifndef NDEBUG
-        if (inp_count)
-            printf("resampled from %i to: %i, lost %i samples\n",fs_inp, fs_outp, inp_count);
-        #endif
-        delete[] input;
-        input = nullptr;
-        return p;
-    }
 };
 
 #endif
@@ -0,0 +1,243 @@
+/*
+ * DirectPath.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+
+#pragma once
+
+#ifndef DIRECTPATH_H
+#define DIRECTPATH_H
+
+/****************************************************************
+        class DirectPath - play the loop without the stretcher while
+                           speed and pitch are neutral, cross fade to
+                           the stretcher output when it is switched in
+                           or out, the stretcher latency is compensated
+                           from a history of the input, so both sides
+                           of the fade play the same frames
+****************************************************************/
+
+// length of the cross fade between the direct path and the stretcher
+#define DIRECT_FADE_FRAMES 2048
+// frames of input kept to line up with the stretcher latency
+#define DIRECT_HISTORY_FRAMES ((uint32_t)1 << 15)
+
+class DirectPath {
+public:
+    DirectPath()
+        : capacity(0),
+          head(0),
+          fill(0),
+          slack(0),
+          drainPos(0),
+          histPos(0),
+          chan(0),
+          fade(0.0f),
+          target(0.0f) {}
+
+    ~DirectPath() {
+        for (uint32_t c = 0; c < chan; c++) {
+            delete[] fifo[c];
+            delete[] history[c];
+        }
+    }
+
+    // allocate the buffers for blocks of up to frames, not real-time safe
+    void setup(uint32_t channels, uint32_t frames) {
+        for (uint32_t c = 0; c < chan; c++) {
+            delete[] fifo[c];
+            delete[] history[c];
+        }
+        chan = std::min<uint32_t>(channels, 2);
+        capacity = DIRECT_HISTORY_FRAMES + 4 * frames;
+        for (uint32_t c = 0; c < chan; c++) {
+            fifo[c] = new float[capacity];
+            history[c] = new float[DIRECT_HISTORY_FRAMES];
+            std::memset(history[c], 0, DIRECT_HISTORY_FRAMES * sizeof(float));
+        }
+        histPos = 0;
+        reset();
+    }
+
+    // drop the frames in the pipe, a running fade jump to its end
+    void reset() noexcept {
+        head = 0;
+        fill = 0;
+        slack = 0;
+        drainPos = 0;
+        fade = target;
+    }
+
+    // select the path for the next block, return true when the stretcher
+    // is switched in and must be started new, latency is the number of
+    // input frames the stretcher hold back
+    bool select(bool neutral, uint32_t latency) noexcept {
+        if (neutral && target > 0.5f) {
+            target = 0.0f;
+            // the direct path wasn't fed, start it from the history
+            if (fade >= 1.0f) prefill(latency);
+            return false;
+        }
+        if (!neutral && target < 0.5f) {
+            target = 1.0f;
+            // stop dropping frames, the stretcher must line up with the pipe
+            slack = 0;
+            drainPos = 0;
+            return fade <= 0.0f;
+        }
+        return false;
+    }
+
+    // the stretcher output is needed
+    inline bool useEngine() const noexcept {
+        return fade > 0.0f || target > 0.5f;
+    }
+
+    // the direct output is needed
+    inline bool useDirect() const noexcept {
+        return fade < 1.0f || target < 0.5f;
+    }
+
+    // frames held in the pipe, the stretcher get them when it is started
+    inline uint32_t pending() const noexcept {
+        return fill;
+    }
+
+    // planar view of the frames in the pipe, from offset on
+    inline void pendingFrames(uint32_t offset, float** dest) const noexcept {
+        for (uint32_t c = 0; c < chan; c++) dest[c] = fifo[c] + head + offset;
+    }
+
+    // frames which could be retrieved
+    inline uint32_t available() const noexcept {
+        return fill > slack ? fill - slack : 0;
+    }
+
+    // number of input frames to get the given number of output frames
+    inline uint32_t required(uint32_t frames) const noexcept {
+        const uint32_t need = frames + slack;
+        const uint32_t more = need > fill ? need - fill : 1;
+        return std::max<uint32_t>(1, std::min(more, capacity - fill));
+    }
+
+    // append planar input frames
+    void process(const float *const *input, uint32_t frames) noexcept {
+        remember(input, frames);
+        frames = std::min(frames, capacity - fill);
+        if (head + fill + frames > capacity) {
+            for (uint32_t c = 0; c < chan; c++)
+                std::memmove(fifo[c], fifo[c] + head, fill * sizeof(float));
+            head = 0;
+        }
+        for (uint32_t c = 0; c < chan; c++)
+            std::memcpy(fifo[c] + head + fill, input[c], frames * sizeof(float));
+        fill += frames;
+    }
+
+    // keep the input in the history only, while the stretcher play alone
+    void remember(const float *const *input, uint32_t frames) noexcept {
+        const uint32_t skip = frames > DIRECT_HISTORY_FRAMES ? frames - DIRECT_HISTORY_FRAMES : 0;
+        for (uint32_t i = skip; i < frames; ) {
+            const uint32_t n = std::min(frames - i, DIRECT_HISTORY_FRAMES - histPos);
+            for (uint32_t c = 0; c < chan; c++)
+                std::memcpy(history[c] + histPos, input[c] + i, n * sizeof(float));
+            histPos = (histPos + n) & (DIRECT_HISTORY_FRAMES - 1);
+            i += n;
+        }
+    }
+
+    // copy frames to planar output, the frames held back after the
+    // stretcher got switched out are dropped with a cross fade,
+    // so the latency goes back to zero
+    uint32_t retrieve(float *const *output, uint32_t frames) noexcept {
+        frames = std::min(frames, available());
+        uint32_t i = 0;
+        for (; i < frames && slack; i++) {
+            const float g = (float)(++drainPos) / DIRECT_FADE_FRAMES;
+            for (uint32_t c = 0; c < chan; c++) {
+                const float a = fifo[c][head];
+                output[c][i] = a + g * (fifo[c][head + slack] - a);
+            }
+            pop(1);
+            if (drainPos == DIRECT_FADE_FRAMES) {
+                pop(slack);
+                slack = 0;
+                drainPos = 0;
+                frames = std::min(frames, i + 1 + fill);
+            }
+        }
+        const uint32_t n = frames - i;
+        for (uint32_t c = 0; c < chan; c++)
+            std::memcpy(output[c] + i, fifo[c] + head, n * sizeof(float));
+        pop(n);
+        return frames;
+    }
+
+    // cross fade the direct frames into the stretcher output
+    uint32_t mix(float *const *output, uint32_t frames) noexcept {
+        frames = std::min(frames, fill);
+        const float step = 1.0f / DIRECT_FADE_FRAMES;
+        for (uint32_t i = 0; i < frames; i++) {
+            fade = target > fade ? std::min(1.0f, fade + step) : std::max(0.0f, fade - step);
+            for (uint32_t c = 0; c < chan; c++) {
+                const float a = fifo[c][head + i];
+                output[c][i] = a + fade * (output[c][i] - a);
+            }
+        }
+        pop(frames);
+        // the direct path is switched out, drop what is left
+        if (fade >= 1.0f) head = fill = 0;
+        // the stretcher is switched out, what the pipe hold is latency now
+        if (fade <= 0.0f) {
+            slack = fill;
+            drainPos = 0;
+        }
+        return frames;
+    }
+
+private:
+    float* fifo[2];
+    float* history[2];
+    uint32_t capacity;
+    uint32_t head;
+    uint32_t fill;
+    uint32_t slack;
+    uint32_t drainPos;
+    uint32_t histPos;
+    uint32_t chan;
+    float fade;
+    float target;
+
+    // start the pipe with the last frames of the history
+    void prefill(uint32_t frames) noexcept {
+        frames = std::min(frames, DIRECT_HISTORY_FRAMES - 1);
+        const uint32_t start = (histPos - frames) & (DIRECT_HISTORY_FRAMES - 1);
+        for (uint32_t c = 0; c < chan; c++) {
+            for (uint32_t i = 0; i < frames; i++)
+                fifo[c][i] = history[c][(start + i) & (DIRECT_HISTORY_FRAMES - 1)];
+        }
+        head = 0;
+        fill = frames;
+        slack = 0;
+        drainPos = 0;
+    }
+
+    // remove frames from the front of the pipe
+    inline void pop(uint32_t frames) noexcept {
+        frames = std::min(frames, fill);
+        head += frames;
+        fill -= frames;
+        if (!fill) head = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,336 @@
+/*
+ * DiskStream.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <thread>
+#include <sndfile.hh>
+
+#include "ParallelThread.h"
+
+
+#pragma once
+
+#ifndef DISKSTREAM_H
+#define DISKSTREAM_H
+
+/****************************************************************
+        class DiskStream - stream a Audio File from disk,
+                           a reader thread keep a fixed set of
+                           blocks filled ahead of the play-head,
+                           the blocks at the loop start stay pinned,
+                           so memory usage didn't depend on file length
+****************************************************************/
+
+// decoded size (in bytes) from where on a file is streamed from disk
+#define STREAM_THRESHOLD ((uint64_t)512 * 1024 * 1024)
+// frames per block, must be a power of two
+#define STREAM_BLOCK_SHIFT 15
+#define STREAM_BLOCK_FRAMES ((uint32_t)1 << STREAM_BLOCK_SHIFT)
+// number of blocks held in memory
+#define STREAM_BLOCKS ((uint32_t)48)
+// max number of blocks read from disk per reader cycle
+#define STREAM_READS_PER_CYCLE ((uint32_t)6)
+// frames in the wave view overview
+#define STREAM_OVERVIEW_FRAMES ((uint32_t)8192)
+
+class DiskStream {
+public:
+    uint32_t channels;
+    uint32_t samplesize;
+    // peak overview for the wave view, filled in by the reader thread,
+    // the bins below overviewDone are done and not touched anymore
+    std::vector<float> overview;
+    std::atomic<uint32_t> overviewDone;
+
+    DiskStream()
+        : channels(0),
+          samplesize(0),
+          overviewDone(0),
+          sndfile(nullptr),
+          direct(nullptr),
+          cache(nullptr),
+          scratch(nullptr),
+          nblocks(0),
+          scanBlock(0),
+          playPos(0),
+          loopL(0),
+          loopR(0),
+          backwards(false),
+          inUse(-1) {
+        for (uint32_t s = 0; s < STREAM_BLOCKS; s++) slotBlock[s] = -1;
+    }
+
+    ~DiskStream() {
+        close();
+    }
+
+    // open a file for streaming and read the first blocks
+    bool open(const char* file, const SF_INFO& info) {
+        close();
+        SF_INFO sinfo;
+        sinfo.format = 0;
+        sndfile = sf_open(file, SFM_READ, &sinfo);
+        if (!sndfile) {
+            std::cerr << "Error: could not open file for streaming " << sf_error (sndfile) << std::endl;
+            return false;
+        }
+        fileName = file;
+        channels = info.channels;
+        samplesize = (uint32_t) std::min<sf_count_t>(info.frames, UINT32_MAX);
+        nblocks = (samplesize + STREAM_BLOCK_FRAMES - 1) >> STREAM_BLOCK_SHIFT;
+        try {
+            cache = new float[(size_t)STREAM_BLOCKS * STREAM_BLOCK_FRAMES * channels];
+            scratch = new float[(size_t)STREAM_BLOCK_FRAMES * channels];
+            blockMap.reset(new std::atomic<int32_t>[nblocks]);
+        } catch (...) {
+            std::cerr << "Error: could not allocate stream buffer" << std::endl;
+            close();
+            return false;
+        }
+        for (uint32_t b = 0; b < nblocks; b++) blockMap[b].store(-1, std::memory_order_relaxed);
+        for (uint32_t s = 0; s < STREAM_BLOCKS; s++) slotBlock[s] = -1;
+        overview.assign((size_t)STREAM_OVERVIEW_FRAMES * channels, 0.0f);
+        overviewDone.store(0, std::memory_order_release);
+        scanBlock = 0;
+        setPlayHead(0, 0, samplesize, false);
+        // read the blocks needed to start playback before the thread runs
+        fill();
+        reader.setThreadName("DiskStream");
+        reader.set<DiskStream, &DiskStream::fill>(this);
+        reader.startTimeout(10);
+        return true;
+    }
+
+    // stop the reader thread and release all buffers
+    void close() {
+        reader.stop();
+        if (sndfile) sf_close(sndfile);
+        sndfile = nullptr;
+        if (direct) sf_close(direct);
+        direct = nullptr;
+        delete[] cache;
+        cache = nullptr;
+        delete[] scratch;
+        scratch = nullptr;
+        blockMap.reset();
+        nblocks = 0;
+        samplesize = 0;
+    }
+
+    inline bool isOpen() const noexcept {
+        return sndfile != nullptr;
+    }
+
+    // tell the reader thread where the play-head is,
+    // called from the audio thread once per cycle
+    inline void setPlayHead(uint32_t pos, uint32_t l, uint32_t r, bool back) noexcept {
+        playPos.store(pos, std::memory_order_relaxed);
+        loopL.store(l, std::memory_order_relaxed);
+        loopR.store(r, std::memory_order_relaxed);
+        backwards.store(back, std::memory_order_release);
+    }
+
+    // get a interleaved frame, return nullptr when the block isn't on hand,
+    // the block stay pinned until release(), so the reader thread didn't
+    // overwrite it meanwhile, called from the audio thread only
+    inline const float* frame(uint32_t pos) noexcept {
+        const uint32_t b = pos >> STREAM_BLOCK_SHIFT;
+        if (b >= nblocks) return nullptr;
+        int32_t s = blockMap[b].load(std::memory_order_acquire);
+        if (s < 0) return nullptr;
+        // pin the slot, then check that it still hold the block, the reader
+        // unmap a block before it check the pin, so one of both see the other
+        inUse.store(s, std::memory_order_seq_cst);
+        if (blockMap[b].load(std::memory_order_seq_cst) != s) {
+            inUse.store(-1, std::memory_order_release);
+            return nullptr;
+        }
+        return &cache[((size_t)s * STREAM_BLOCK_FRAMES + (pos & (STREAM_BLOCK_FRAMES - 1))) * channels];
+    }
+
+    // let the reader thread reuse the block got by frame()
+    inline void release() noexcept {
+        inUse.store(-1, std::memory_order_release);
+    }
+
+    // read frames directly from disk (not real-time safe), used to save a loop
+    uint32_t read(uint32_t pos, float* buffer, uint32_t frames) {
+        if (!direct) {
+            SF_INFO info;
+            info.format = 0;
+            direct = sf_open(fileName.c_str(), SFM_READ, &info);
+        }
+        uint32_t count = 0;
+        if (direct && pos < samplesize && sf_seek(direct, pos, SEEK_SET) >= 0)
+            count = (uint32_t) sf_readf_float(direct, buffer, std::min(frames, samplesize - pos));
+        std::memset(&buffer[(size_t)count * channels], 0, (size_t)(frames - count) * channels * sizeof(float));
+        return count;
+    }
+
+    // copy the finished bins of the overview, the others are left zero,
+    // called from the UI thread
+    void copyOverview(std::vector<float>& dest) const {
+        const size_t done = (size_t)overviewDone.load(std::memory_order_acquire) * channels;
+        dest.assign(overview.size(), 0.0f);
+        std::memcpy(dest.data(), overview.data(), std::min(done, overview.size()) * sizeof(float));
+    }
+
+    // raise a overview bin to v, the bins where segments meet are
+    // shared by parallel decoders, and the UI read them meanwhile
+    static inline void raisePeak(float& bin, float v) noexcept {
+        std::atomic_ref<float> peak(bin);
+        float old = peak.load(std::memory_order_relaxed);
+        while (v > old && !peak.compare_exchange_weak(old, v, std::memory_order_relaxed)) {}
+    }
+
+    // copy a overview while it is raised, called from the UI thread
+    static void copyPeaks(std::vector<float>& overview, std::vector<float>& dest) {
+        dest.resize(overview.size());
+        for (size_t i = 0; i < overview.size(); i++)
+            dest[i] = std::atomic_ref<float>(overview[i]).load(std::memory_order_relaxed);
+    }
+
+    // add the peaks of decoded frames to a overview of STREAM_OVERVIEW_FRAMES
+    template <typename T>
+    static void addPeaks(std::vector<float>& overview, uint32_t chan, uint32_t size,
+            uint64_t start, const T* buffer, uint32_t frames, float scale = 1.0f) {
+        for (uint32_t i = 0; i < frames; i++) {
+            uint32_t o = (uint32_t)(((start + i) * STREAM_OVERVIEW_FRAMES) / size);
+            for (uint32_t c = 0; c < chan; c++)
+                raisePeak(overview[o * chan + c], std::fabs((float)buffer[i * chan + c] * scale));
+        }
+    }
+
+private:
+    std::string fileName;
+    SNDFILE* sndfile;
+    SNDFILE* direct;
+    float* cache;
+    float* scratch;
+    std::unique_ptr<std::atomic<int32_t>[]> blockMap;
+    int32_t slotBlock[STREAM_BLOCKS];
+    uint32_t nblocks;
+    uint32_t scanBlock;
+    std::atomic<uint32_t> playPos;
+    std::atomic<uint32_t> loopL;
+    std::atomic<uint32_t> loopR;
+    std::atomic<bool> backwards;
+    // the slot the audio thread copy from right now
+    std::atomic<int32_t> inUse;
+    ParallelThread reader;
+
+    // decode a block from disk into the given buffer,
+    // return the frames read, the rest of the block is silent
+    uint32_t readBlock(uint32_t b, float* buffer) {
+        uint32_t start = b << STREAM_BLOCK_SHIFT;
+        uint32_t frames = std::min(STREAM_BLOCK_FRAMES, samplesize - start);
+        uint32_t count = 0;
+        if (sf_seek(sndfile, start, SEEK_SET) >= 0)
+            count = (uint32_t) sf_readf_float(sndfile, buffer, frames);
+        std::memset(&buffer[(size_t)count * channels], 0,
+            (size_t)(STREAM_BLOCK_FRAMES - count) * channels * sizeof(float));
+        return count;
+    }
+
+    // collect the blocks needed next, in the order they will be played
+    uint32_t wantedBlocks(uint32_t* want) {
+        uint32_t pos = playPos.load(std::memory_order_relaxed);
+        uint32_t l = loopL.load(std::memory_order_relaxed);
+        uint32_t r = loopR.load(std::memory_order_relaxed);
+        bool back = backwards.load(std::memory_order_acquire);
+        if (r > samplesize || r <= l) {
+            l = 0;
+            r = samplesize;
+        }
+        const uint32_t first = l >> STREAM_BLOCK_SHIFT;
+        const uint32_t last = (r - 1) >> STREAM_BLOCK_SHIFT;
+        uint32_t b = std::min(pos >> STREAM_BLOCK_SHIFT, nblocks - 1);
+        uint32_t n = 0;
+        auto add = [&] (uint32_t block) {
+            for (uint32_t i = 0; i < n; i++) if (want[i] == block) return false;
+            want[n++] = block;
+            return true;
+        };
+        add(b);
+        // keep the blocks played after the loop wrap pinned
+        if (back) {
+            add(last);
+            if (last > first) add(last - 1);
+        } else {
+            add(first);
+            if (first < last) add(first + 1);
+        }
+        // fill up with the blocks ahead of the play-head
+        while (n < STREAM_BLOCKS - 2) {
+            if (back) b = (b <= first || b > last) ? last : b - 1;
+            else b = (b >= last || b < first) ? first : b + 1;
+            if (!add(b)) break;
+        }
+        return n;
+    }
+
+    // the reader thread, keep the wanted blocks in memory
+    void fill() {
+        if (!sndfile) return;
+        uint32_t want[STREAM_BLOCKS];
+        uint32_t n = wantedBlocks(want);
+        uint32_t reads = 0;
+        for (uint32_t w = 0; w < n && reads < STREAM_READS_PER_CYCLE; w++) {
+            if (blockMap[want[w]].load(std::memory_order_relaxed) >= 0) continue;
+            // take a free slot, or the first one not wanted anymore
+            int32_t victim = -1;
+            for (uint32_t s = 0; s < STREAM_BLOCKS && victim < 0; s++)
+                if (slotBlock[s] < 0) victim = s;
+            for (uint32_t s = 0; s < STREAM_BLOCKS && victim < 0; s++) {
+                bool wanted = false;
+                for (uint32_t i = 0; i < n && !wanted; i++) wanted = (want[i] == (uint32_t)slotBlock[s]);
+                if (!wanted) victim = s;
+            }
+            if (victim < 0) break;
+            if (slotBlock[victim] >= 0) {
+                blockMap[slotBlock[victim]].store(-1, std::memory_order_seq_cst);
+                // the audio thread may still copy from the slot, wait it out,
+                // it hold it for one span of a period only
+                while (inUse.load(std::memory_order_seq_cst) == victim) std::this_thread::yield();
+            }
+            float* slot = &cache[(size_t)victim * STREAM_BLOCK_FRAMES * channels];
+            slotBlock[victim] = -1;
+            // a failed read is tried again in the next cycle
+            if (!readBlock(want[w], slot)) break;
+            slotBlock[victim] = want[w];
+            blockMap[want[w]].store(victim, std::memory_order_release);
+            reads++;
+        }
+        // when idle, scan the file block by block for the wave view
+        for (uint32_t scans = 0; !reads && scanBlock < nblocks && scans < STREAM_READS_PER_CYCLE; scans++) {
+            const float* buffer = scratch;
+            const uint64_t start = (uint64_t)scanBlock << STREAM_BLOCK_SHIFT;
+            uint32_t frames = std::min(STREAM_BLOCK_FRAMES, samplesize - (uint32_t)start);
+            int32_t s = blockMap[scanBlock].load(std::memory_order_relaxed);
+            if (s >= 0) buffer = &cache[(size_t)s * STREAM_BLOCK_FRAMES * channels];
+            else frames = readBlock(scanBlock, scratch);
+            addPeaks(overview, channels, samplesize, start, buffer, frames);
+            scanBlock++;
+            // the bin at the block end is shared with the next block,
+            // so only the bins before it are published
+            const uint64_t end = std::min<uint64_t>((uint64_t)scanBlock << STREAM_BLOCK_SHIFT, samplesize);
+            overviewDone.store(scanBlock == nblocks ? STREAM_OVERVIEW_FRAMES :
+                (uint32_t)((end * STREAM_OVERVIEW_FRAMES) / samplesize), std::memory_order_release);
+        }
+    }
+};
+
+#endif
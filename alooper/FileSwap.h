@@ -0,0 +1,197 @@
+/*
+ * FileSwap.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <cstdint>
+
+#include "ParallelThread.h"
+#include "AudioFile.h"
+#include "PreloadCache.h"
+
+
+#pragma once
+
+#ifndef FILESWAP_H
+#define FILESWAP_H
+
+/****************************************************************
+        class FileSwap - hand a new loaded Audio File to the audio
+                         worker with a single pointer store, the
+                         worker pick it up at the next period, the
+                         replaced file is handed to the pre-load
+                         cache by a reclaimer thread, once the worker
+                         started a period after the swap (grace period),
+                         for gapless play the next file could be staged,
+                         the worker then take it and swap it in itself
+****************************************************************/
+
+class FileSwap {
+public:
+    FileSwap()
+        : cache(nullptr),
+          current(new AudioFile()),
+          staged(nullptr),
+          dropped(nullptr),
+          stagedL(0),
+          stagedR(0),
+          swaps(0),
+          passed(0),
+          active(false) {}
+
+    ~FileSwap() {
+        reclaimer.stop();
+        for (auto& r : retired) delete r.af;
+        delete staged.load(std::memory_order_acquire);
+        delete dropped.load(std::memory_order_acquire);
+        delete current.load(std::memory_order_acquire);
+    }
+
+    // the cache the replaced files are handed to
+    void setCache(PreloadCache* c) noexcept {
+        cache = c;
+    }
+
+    // the current file, for the loader side only
+    inline AudioFile* get() const noexcept {
+        return current.load(std::memory_order_relaxed);
+    }
+
+    // number of swaps done, the generation of the current file
+    inline uint32_t generation() const noexcept {
+        return swaps.load(std::memory_order_acquire);
+    }
+
+    // hand the next file to the audio worker, return the replaced one,
+    // it's not the loader's one when the worker swapped in a staged file
+    AudioFile* publish(AudioFile* next) {
+        AudioFile* old = current.exchange(next);
+        swaps.fetch_add(1);
+        return old;
+    }
+
+    // release a file no longer played (loaded from file) after the
+    // grace period, called from the loader
+    void retire(AudioFile* af, const std::string& file) {
+        {
+            std::lock_guard<std::mutex> lk(retireMutex);
+            retired.push_back({af, file, swaps.load()});
+        }
+        if (!reclaimer.isRunning()) {
+            reclaimer.setThreadName("Reclaim");
+            reclaimer.set<FileSwap, &FileSwap::reclaim>(this);
+            reclaimer.startTimeout(50);
+        }
+    }
+
+    // stage the file to play after the current one, with its loop points,
+    // called from the loader when nothing is staged
+    void stage(AudioFile* next, uint32_t l, uint32_t r) noexcept {
+        stagedL = l;
+        stagedR = r;
+        staged.store(next, std::memory_order_release);
+    }
+
+    // take back the staged file, nullptr when the worker got it before
+    inline AudioFile* unstage() noexcept {
+        return staged.exchange(nullptr, std::memory_order_acq_rel);
+    }
+
+    // take the staged file and its loop points, called from the audio worker
+    inline AudioFile* takeStaged(uint32_t& l, uint32_t& r) noexcept {
+        if (!staged.load(std::memory_order_relaxed) || dropped.load(std::memory_order_acquire))
+            return nullptr;
+        AudioFile* f = staged.exchange(nullptr, std::memory_order_acq_rel);
+        if (f) {
+            l = stagedL;
+            r = stagedR;
+        }
+        return f;
+    }
+
+    // swap the taken file in for the played one, gen get its generation,
+    // called from the audio worker, fail when the loader published
+    // a other file meanwhile
+    inline bool commit(AudioFile* from, AudioFile* to, uint32_t& gen) noexcept {
+        if (!current.compare_exchange_strong(from, to)) return false;
+        gen = swaps.fetch_add(1) + 1;
+        return true;
+    }
+
+    // give up a taken file, it's freed by the reclaimer,
+    // called from the audio worker
+    inline void drop(AudioFile* f) noexcept {
+        dropped.store(f, std::memory_order_release);
+    }
+
+    // get the file to play in this period, called from the audio worker
+    // at the period start, the file get before isn't used anymore
+    inline AudioFile* acquire() noexcept {
+        active.store(true);
+        const uint32_t gen = swaps.load();
+        AudioFile* f = current.load();
+        passed.store(gen, std::memory_order_release);
+        return f;
+    }
+
+    // mark that the audio worker hold no file, called when it go idle
+    inline void release() noexcept {
+        active.store(false, std::memory_order_release);
+    }
+
+private:
+    struct Retired {
+        AudioFile* af;
+        std::string file;
+        uint32_t gen;
+    };
+
+    PreloadCache* cache;
+    std::atomic<AudioFile*> current;
+    // the file to swap in at the next loop wrap, and the one the worker gave up
+    std::atomic<AudioFile*> staged;
+    std::atomic<AudioFile*> dropped;
+    uint32_t stagedL;
+    uint32_t stagedR;
+    // number of swaps done, and the number the worker has seen
+    std::atomic<uint32_t> swaps;
+    std::atomic<uint32_t> passed;
+    // the worker is within a run of periods
+    std::atomic<bool> active;
+    std::mutex retireMutex;
+    std::list<Retired> retired;
+    ParallelThread reclaimer;
+
+    // the reclaimer thread, release the files the worker let go,
+    // a idle worker take the current file when it wake up again,
+    // so all files swapped out before it was seen idle are free
+    void reclaim() {
+        const uint32_t swapped = swaps.load();
+        const bool idle = !active.load();
+        const uint32_t seen = passed.load(std::memory_order_acquire);
+        std::list<Retired> done;
+        {
+            std::lock_guard<std::mutex> lk(retireMutex);
+            for (auto it = retired.begin(); it != retired.end();) {
+                auto r = it++;
+                if ((int32_t)(seen - r->gen) >= 0 || (idle && (int32_t)(swapped - r->gen) >= 0))
+                    done.splice(done.end(), retired, r);
+            }
+        }
+        for (auto& r : done) {
+            if (cache && !r.file.empty()) cache->put(r.file, *r.af);
+            delete r.af;
+        }
+        delete dropped.exchange(nullptr, std::memory_order_acq_rel);
+    }
+};
+
+#endif
@@ -0,0 +1,158 @@
+/*
+ * LoopSeam.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <cstdint>
+
+#include "AudioFile.h"
+
+
+#pragma once
+
+#ifndef LOOPSEAM_H
+#define LOOPSEAM_H
+
+/****************************************************************
+        class LoopSeam - the overlap cross fade at the loop points,
+                         the tail before the loop end is blended
+                         into the head after the loop start with a
+                         equal power curve, the seam is rendered on
+                         the UI side whenever the loop change, the
+                         audio worker play through it and go on
+                         behind the head at the loop wrap
+****************************************************************/
+
+// channels held in the seam, as the stretcher
+#define LOOP_SEAM_CHANNELS ((uint32_t)2)
+
+class LoopSeam {
+public:
+    struct Seam {
+        // the file generation, the loop and the play direction it's made for
+        uint32_t gen;
+        uint32_t l;
+        uint32_t r;
+        bool backwards;
+        // frames in play order
+        uint32_t frames;
+        std::vector<float> data[LOOP_SEAM_CHANNELS];
+    };
+
+    LoopSeam()
+        : maxFrames(0),
+          lastGen(0),
+          lastL(0),
+          lastR(0),
+          lastBackwards(false),
+          current(nullptr),
+          pending(nullptr),
+          freed(nullptr) {}
+
+    ~LoopSeam() {
+        delete current;
+        delete pending.load(std::memory_order_acquire);
+        delete freed.load(std::memory_order_acquire);
+    }
+
+    // set the seam length in frames, 0 switch the seam off
+    void setup(uint32_t frames) noexcept {
+        maxFrames = frames;
+    }
+
+    // check if the loop is played with a seam
+    inline bool enabled() const noexcept {
+        return maxFrames != 0;
+    }
+
+    // render the seam for the loop of af, when it changed,
+    // called from the UI side only, the file must stay while it run
+    void render(const AudioFile* af, uint32_t gen, uint32_t l, uint32_t r, bool backwards) {
+        // free a seam the worker handed back, on every call, so the worker
+        // could take the next one even when it was published meanwhile
+        delete freed.exchange(nullptr, std::memory_order_acq_rel);
+        if (!maxFrames || (gen == lastGen && l == lastL && r == lastR && backwards == lastBackwards))
+            return;
+        // a disk stream hold only the frames around the play-head,
+        // a file in progress is done when the loop is decoded
+        if (!af->isLoaded() || af->stream || !af->channels || r <= l + 2) return;
+        // backward the head start at the loop end, a loop over the
+        // whole file start at the last frame
+        const uint32_t top = std::min(r, af->samplesize - 1);
+        if (af->loaded.load(std::memory_order_acquire) <= top) return;
+        lastGen = gen;
+        lastL = l;
+        lastR = r;
+        lastBackwards = backwards;
+
+        Seam* s = new Seam();
+        s->gen = gen;
+        s->l = l;
+        s->r = r;
+        s->backwards = backwards;
+        s->frames = std::min(maxFrames, (r - l) / 2);
+        const uint32_t n = s->frames;
+        std::vector<float> tail[LOOP_SEAM_CHANNELS];
+        std::vector<float> head[LOOP_SEAM_CHANNELS];
+        float* t[LOOP_SEAM_CHANNELS];
+        float* h[LOOP_SEAM_CHANNELS];
+        for (uint32_t c = 0; c < LOOP_SEAM_CHANNELS; c++) {
+            tail[c].resize(n);
+            head[c].resize(n);
+            s->data[c].resize(n);
+            t[c] = tail[c].data();
+            h[c] = head[c].data();
+        }
+        const uint32_t chan = std::min(af->channels, LOOP_SEAM_CHANNELS);
+        // forward the tail run up to the loop end and the head from the
+        // loop start on, backward down to the loop start and from the end on
+        af->readPlanar(backwards ? l + n : r - n, n, backwards, t, 0, chan);
+        af->readPlanar(backwards ? top : l, n, backwards, h, 0, chan);
+        for (uint32_t c = 0; c < LOOP_SEAM_CHANNELS; c++) {
+            const float* ts = t[std::min(c, chan - 1)];
+            const float* hs = h[std::min(c, chan - 1)];
+            float* d = s->data[c].data();
+            for (uint32_t k = 0; k < n; k++) {
+                const double a = M_PI_2 * (k + 0.5) / n;
+                d[k] = ts[k] * std::cos(a) + hs[k] * std::sin(a);
+            }
+        }
+        // a seam the worker didn't take yet is replaced
+        delete pending.exchange(s, std::memory_order_acq_rel);
+    }
+
+    // get the latest seam, called from the audio worker at the period
+    // start, a replaced seam is handed back to be freed on the UI side
+    inline const Seam* acquire() noexcept {
+        if (pending.load(std::memory_order_relaxed) && !freed.load(std::memory_order_acquire)) {
+            Seam* s = pending.exchange(nullptr, std::memory_order_acq_rel);
+            if (s) {
+                freed.store(current, std::memory_order_release);
+                current = s;
+            }
+        }
+        return current;
+    }
+
+private:
+    uint32_t maxFrames;
+    // the loop the last seam was rendered for
+    uint32_t lastGen;
+    uint32_t lastL;
+    uint32_t lastR;
+    bool lastBackwards;
+    // the seam played by the worker, the next one and the one to free
+    Seam* current;
+    std::atomic<Seam*> pending;
+    std::atomic<Seam*> freed;
+};
+
+#endif
@@ -0,0 +1,84 @@
+/*
+ * ParamSnapshot.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+
+
+#pragma once
+
+#ifndef PARAMSNAPSHOT_H
+#define PARAMSNAPSHOT_H
+
+/****************************************************************
+        class ParamSnapshot - hand the play parameters from the
+                              UI threads to the audio worker, a
+                              triple buffer, so the worker get a
+                              consistent set once per period without
+                              ever waiting, the UI threads publish
+                              a whole set at once
+****************************************************************/
+
+// the parameters the audio worker read once per period
+struct PlayParams {
+    float gain;
+    float timeRatio;
+    float pitchScale;
+    uint32_t loopPoint_l;
+    uint32_t loopPoint_r;
+    bool play;
+    bool playBackwards;
+    bool ready;
+    // the play-head is owned by the worker, the UI request a move of it,
+    // a new seekCount tell the worker to jump to seekPosition
+    uint32_t seekPosition;
+    uint32_t seekCount;
+    // the play list advance gapless at the loop wrap
+    bool gapless;
+    // the file generation the loop points belong to
+    uint32_t fileGen;
+};
+
+class ParamSnapshot {
+public:
+    ParamSnapshot()
+        : writeSlot(0),
+          readSlot(2),
+          back(1) {
+        slots[0] = slots[1] = slots[2] = PlayParams();
+    }
+
+    // publish a new set, called from the UI threads only
+    void publish(const PlayParams& p) {
+        std::lock_guard<std::mutex> lk(writeMutex);
+        slots[writeSlot] = p;
+        writeSlot = back.exchange(writeSlot | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // get the latest set, called from the audio worker only, wait-free
+    inline const PlayParams& read() noexcept {
+        if (back.load(std::memory_order_relaxed) & FRESH)
+            readSlot = back.exchange(readSlot, std::memory_order_acq_rel) & INDEX;
+        return slots[readSlot];
+    }
+
+private:
+    static constexpr uint32_t FRESH = 4;
+    static constexpr uint32_t INDEX = 3;
+
+    PlayParams slots[3];
+    std::mutex writeMutex;
+    uint32_t writeSlot;
+    uint32_t readSlot;
+    // the slot between writer and reader, FRESH when it hold a new set
+    std::atomic<uint32_t> back;
+};
+
+#endif
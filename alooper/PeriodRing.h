@@ -0,0 +1,161 @@
+/*
+ * PeriodRing.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+
+
+#pragma once
+
+#ifndef PERIODRING_H
+#define PERIODRING_H
+
+/****************************************************************
+        class PeriodRing - lock-free single producer, single
+                           consumer ring of rendered stereo periods,
+                           the audio worker render into the free
+                           slots up to the prefetch depth, the audio
+                           callback only copy from the filled ones
+****************************************************************/
+
+// max number of periods held in the ring
+#define PERIOD_RING_SLOTS ((uint32_t)8)
+
+class PeriodRing {
+public:
+    PeriodRing()
+        : maxFrames(0),
+          depth(1),
+          readOffset(0),
+          head(0),
+          tail(0),
+          queued(0),
+          underruns(0) {
+        for (uint32_t s = 0; s < PERIOD_RING_SLOTS; s++) {
+            slots[s].data[0] = slots[s].data[1] = nullptr;
+            slots[s].frames = 0;
+        }
+    }
+
+    ~PeriodRing() {
+        release();
+    }
+
+    // allocate the slots for periods of up to frames, not real-time safe
+    void setup(uint32_t frames) {
+        release();
+        maxFrames = frames;
+        for (uint32_t s = 0; s < PERIOD_RING_SLOTS; s++) {
+            for (uint32_t c = 0; c < 2; c++) {
+                slots[s].data[c] = new float[maxFrames];
+                std::memset(slots[s].data[c], 0, maxFrames * sizeof(float));
+            }
+            slots[s].frames = 0;
+        }
+        readOffset = 0;
+        head.store(0, std::memory_order_release);
+        tail.store(0, std::memory_order_release);
+        queued.store(0, std::memory_order_relaxed);
+    }
+
+    // set the number of callback periods rendered ahead
+    inline void setDepth(uint32_t d) noexcept {
+        depth = std::clamp<uint32_t>(d, 1, PERIOD_RING_SLOTS);
+    }
+
+    // max frames per period
+    inline uint32_t periodFrames() const noexcept {
+        return maxFrames;
+    }
+
+    // number of periods the consumer ran dry
+    inline uint32_t getUnderruns() const noexcept {
+        return underruns.load(std::memory_order_relaxed);
+    }
+
+    // producer: check if a slot should be rendered, the frames queued
+    // must cover depth callbacks of period frames, a callback could ask
+    // for more frames than a slot hold, then it's made of several slots
+    inline bool writable(uint32_t period) const noexcept {
+        return maxFrames && head.load(std::memory_order_relaxed) -
+            tail.load(std::memory_order_acquire) < PERIOD_RING_SLOTS &&
+            queued.load(std::memory_order_relaxed) < (uint64_t)depth * period;
+    }
+
+    // producer: the buffers of the next free slot
+    inline float *const *writeBuffers() noexcept {
+        return slots[head.load(std::memory_order_relaxed) % PERIOD_RING_SLOTS].data;
+    }
+
+    // producer: publish the rendered frames of the slot
+    inline void commit(uint32_t frames) noexcept {
+        const uint32_t h = head.load(std::memory_order_relaxed);
+        slots[h % PERIOD_RING_SLOTS].frames = std::min(frames, maxFrames);
+        queued.fetch_add(std::min(frames, maxFrames), std::memory_order_relaxed);
+        head.store(h + 1, std::memory_order_release);
+    }
+
+    // consumer: copy frames to the planar output, missing frames are silent,
+    // return the number of frames taken from the ring
+    uint32_t pop(float *const *out, uint32_t frames) noexcept {
+        uint32_t done = 0;
+        uint32_t t = tail.load(std::memory_order_relaxed);
+        while (done < frames && t != head.load(std::memory_order_acquire)) {
+            const Slot& s = slots[t % PERIOD_RING_SLOTS];
+            const uint32_t n = std::min(frames - done, s.frames - readOffset);
+            for (uint32_t c = 0; c < 2; c++)
+                std::memcpy(out[c] + done, s.data[c] + readOffset, n * sizeof(float));
+            done += n;
+            readOffset += n;
+            if (readOffset >= s.frames) {
+                readOffset = 0;
+                tail.store(++t, std::memory_order_release);
+            }
+        }
+        queued.fetch_sub(done, std::memory_order_relaxed);
+        if (done < frames) {
+            for (uint32_t c = 0; c < 2; c++)
+                std::memset(out[c] + done, 0, (frames - done) * sizeof(float));
+            underruns.fetch_add(1, std::memory_order_relaxed);
+        }
+        return done;
+    }
+
+private:
+    struct Slot {
+        float* data[2];
+        uint32_t frames;
+    };
+
+    Slot slots[PERIOD_RING_SLOTS];
+    uint32_t maxFrames;
+    uint32_t depth;
+    // frames of the tail slot already read, used by the consumer only
+    uint32_t readOffset;
+    // periods written and read, the slot index is the count modulo the slots
+    std::atomic<uint32_t> head;
+    std::atomic<uint32_t> tail;
+    // frames rendered and not read yet
+    std::atomic<uint32_t> queued;
+    std::atomic<uint32_t> underruns;
+
+    void release() {
+        for (uint32_t s = 0; s < PERIOD_RING_SLOTS; s++) {
+            for (uint32_t c = 0; c < 2; c++) {
+                delete[] slots[s].data[c];
+                slots[s].data[c] = nullptr;
+            }
+        }
+        maxFrames = 0;
+    }
+};
+
+#endif
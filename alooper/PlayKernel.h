@@ -0,0 +1,101 @@
+/*
+ * PlayKernel.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+
+#pragma once
+
+#ifndef PLAYKERNEL_H
+#define PLAYKERNEL_H
+
+/****************************************************************
+        class PlayKernel - the inner loops of the playback, each
+                           specialized for mono or stereo and for
+                           steady or fading state, the kernel is
+                           picked once per block from a table
+****************************************************************/
+
+class PlayKernel {
+public:
+    typedef void (*OutputKernel)(float *const *, const float*, const float*, uint32_t, float, float*);
+
+    // get the kernel to copy planar frames with the gain applied to the
+    // output, while the gain is fading it follow the target by a one pole smoother,
+    // the smoother settle in float a bit off the gain, so it's steady once a
+    // step didn't change it anymore
+    static inline OutputKernel output(bool stereo, float gain, const float* rec) noexcept {
+        static const OutputKernel kernels[2][2] = {
+            { &outputRun<false, false>, &outputRun<false, true> },
+            { &outputRun<true, false>, &outputRun<true, true> }
+        };
+        const float slow = 0.0010000000000000009 * gain;
+        const float next = slow + 0.999 * rec[1];
+        return kernels[stereo][next != rec[1]];
+    }
+
+    // fade out stereo planar frames from offset on, one step per frame,
+    // return the number of frames done before the ramp reached zero
+    static inline uint32_t fadeOut(float *const *out, uint32_t offset, uint32_t frames,
+            float& ramp, float impl) noexcept {
+        const uint32_t n = std::min(frames, (uint32_t)std::max(0.0f, ramp));
+        for (uint32_t c = 0; c < 2; c++) {
+            float* o = out[c] + offset;
+            for (uint32_t i = 0; i < n; i++) o[i] *= (ramp - (float)(i + 1)) * impl;
+        }
+        ramp -= (float)n;
+        return n;
+    }
+
+    // fade in stereo planar frames from offset on, one step per frame,
+    // return the number of frames done before the ramp reached step
+    static inline uint32_t fadeIn(float *const *out, uint32_t offset, uint32_t frames,
+            float& ramp, float step, float impl) noexcept {
+        const uint32_t n = std::min(frames, (uint32_t)std::max(0.0f, step - ramp));
+        for (uint32_t c = 0; c < 2; c++) {
+            float* o = out[c] + offset;
+            for (uint32_t i = 0; i < n; i++) o[i] *= (ramp + (float)(i + 1)) * impl;
+        }
+        ramp += (float)n;
+        return n;
+    }
+
+private:
+    // the mono kernel play the left channel on both outputs,
+    // the steady kernel use the settled smoother value direct, so the loop vectorize
+    template <bool Stereo, bool Fading>
+    static void outputRun(float *const *out, const float* left, const float* right,
+            uint32_t frames, float gain, float* rec) noexcept {
+        if (!Stereo) right = left;
+        float* __restrict l = out[0];
+        float* __restrict r = out[1];
+        if (Fading) {
+            // the smoother state is kept in a register while the loop run
+            const float slow = 0.0010000000000000009 * gain;
+            float y = rec[1];
+            for (uint32_t i = 0; i < frames; i++) {
+                y = slow + 0.999 * y;
+                l[i] = left[i] * y;
+                r[i] = right[i] * y;
+            }
+            rec[0] = rec[1] = y;
+        } else {
+            const float y = rec[1];
+            for (uint32_t i = 0; i < frames; i++) {
+                l[i] = left[i] * y;
+                r[i] = right[i] * y;
+            }
+            rec[0] = y;
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,217 @@
+/*
+ * PreloadCache.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "ParallelThread.h"
+#include "AudioFile.h"
+
+
+#pragma once
+
+#ifndef PRELOADCACHE_H
+#define PRELOADCACHE_H
+
+/****************************************************************
+        class PreloadCache - hold decoded Audio Files in memory,
+                             the next entries of the Play List get
+                             loaded in background, recently played
+                             files stay resident until the memory
+                             budget is used up (least recently used
+                             entries get dropped first)
+****************************************************************/
+
+class PreloadCache {
+public:
+    PreloadCache()
+        : budget(0),
+          ahead(1),
+          samplerate(0),
+          clock(0),
+          dirty(false) {}
+
+    ~PreloadCache() {
+        loader.stop();
+    }
+
+    // set the memory budget (in bytes) and the number of files to load ahead
+    void setup(uint64_t budget_, uint32_t ahead_) {
+        std::lock_guard<std::mutex> lk(cacheMutex);
+        budget = budget_;
+        ahead = ahead_;
+    }
+
+    // set the sample rate the files get loaded for, a change drop all entries
+    void setSampleRate(uint32_t sr) {
+        std::lock_guard<std::mutex> lk(cacheMutex);
+        if (sr != samplerate) entries.clear();
+        samplerate = sr;
+    }
+
+    // number of files to load ahead
+    inline uint32_t getAhead() const noexcept {
+        return ahead;
+    }
+
+    // take a file out of the cache, when the loader decode it right now wait
+    // for it, when it isn't there withdraw it from the wanted files, so the
+    // caller load it and it isn't decoded twice, return false then
+    bool claim(const std::string& file, AudioFile& dest) {
+        std::unique_lock<std::mutex> lk(cacheMutex);
+        loaded.wait(lk, [&] { return loading != file; });
+        for (auto it = entries.begin(); it != entries.end(); it++) {
+            if (it->file == file) {
+                dest.takeOver(*it->af);
+                entries.erase(it);
+                return true;
+            }
+        }
+        const auto w = std::find(wanted.begin(), wanted.end(), file);
+        if (w != wanted.end()) {
+            wanted.erase(w);
+            dirty.store(true, std::memory_order_release);
+        }
+        return false;
+    }
+
+    // hand over a played file to the cache, so it stay resident
+    void put(const std::string& file, AudioFile& src) {
+        if (!src.isLoaded() || src.inProgress()) return;
+        std::lock_guard<std::mutex> lk(cacheMutex);
+        if (isCached(file)) return;
+        Entry e;
+        e.file = file;
+        e.af = std::make_unique<AudioFile>();
+        e.af->takeOver(src);
+        e.lastUse = ++clock;
+        entries.push_back(std::move(e));
+        evict(0);
+    }
+
+    // request that the given files (in play order) get loaded in background
+    void prefetch(const std::vector<std::string>& files) {
+        {
+            std::lock_guard<std::mutex> lk(cacheMutex);
+            wanted = files;
+            // the wanted files are the most recently used ones
+            for (auto f = wanted.rbegin(); f != wanted.rend(); f++)
+                for (auto& e : entries) if (e.file == *f) e.lastUse = ++clock;
+        }
+        dirty.store(true, std::memory_order_release);
+        if (!loader.isRunning()) {
+            loader.setThreadName("PreLoad");
+            loader.set<PreloadCache, &PreloadCache::loadWanted>(this);
+            loader.startTimeout(50);
+        }
+    }
+
+private:
+    struct Entry {
+        std::string file;
+        std::unique_ptr<AudioFile> af;
+        uint64_t lastUse;
+    };
+
+    std::mutex cacheMutex;
+    std::condition_variable loaded;
+    std::list<Entry> entries;
+    std::vector<std::string> wanted;
+    std::string loading;
+    uint64_t budget;
+    uint32_t ahead;
+    uint32_t samplerate;
+    uint64_t clock;
+    std::atomic<bool> dirty;
+    ParallelThread loader;
+
+    // memory held by all entries
+    uint64_t usage() const {
+        uint64_t u = 0;
+        for (auto& e : entries) u += e.af->memoryUsage();
+        return u;
+    }
+
+    // drop least recently used entries until needed bytes fit into the budget,
+    // return false when the wanted files alone exceed the budget
+    bool evict(uint64_t needed) {
+        uint64_t u = usage();
+        while (u + needed > budget && !entries.empty()) {
+            auto victim = entries.begin();
+            for (auto it = entries.begin(); it != entries.end(); it++)
+                if (it->lastUse < victim->lastUse) victim = it;
+            if (needed && isWanted(victim->file)) return false;
+            u -= victim->af->memoryUsage();
+            entries.erase(victim);
+        }
+        return u + needed <= budget;
+    }
+
+    bool isCached(const std::string& file) const {
+        for (auto& e : entries) if (e.file == file) return true;
+        return false;
+    }
+
+    bool isWanted(const std::string& file) const {
+        for (auto& f : wanted) if (f == file) return true;
+        return false;
+    }
+
+    // the background loader, load the wanted files missing in the cache,
+    // stop when the budget is used up by wanted files, the memory a file
+    // need is estimated from its header and made free before it's decoded
+    void loadWanted() {
+        while (dirty.exchange(false, std::memory_order_acq_rel)) {
+            for (uint32_t i = 0; ; i++) {
+                std::string file;
+                uint32_t sr;
+                {
+                    std::lock_guard<std::mutex> lk(cacheMutex);
+                    if (i >= wanted.size()) break;
+                    file = wanted[i];
+                    sr = samplerate;
+                    if (isCached(file)) continue;
+                }
+                // make room before the file is decoded, so the budget hold
+                // while it's loaded too
+                const uint64_t estimate = AudioFile::estimateUsage(file.c_str(), sr);
+                {
+                    std::lock_guard<std::mutex> lk(cacheMutex);
+                    if (sr != samplerate || !isWanted(file) || isCached(file)) continue;
+                    if (dirty.load(std::memory_order_acquire)) break;
+                    if (!evict(estimate)) break;
+                    loading = file;
+                }
+                auto af = std::make_unique<AudioFile>();
+                const bool ok = af->getAudioFile(file.c_str(), sr);
+                std::lock_guard<std::mutex> lk(cacheMutex);
+                // a claim() waiting for this file check the entries now
+                loading.clear();
+                loaded.notify_all();
+                if (!ok) continue;
+                if (sr != samplerate || !isWanted(file) || isCached(file)) continue;
+                if (!evict(af->memoryUsage())) break;
+                Entry e;
+                e.file = file;
+                e.af = std::move(af);
+                e.lastUse = ++clock;
+                entries.push_back(std::move(e));
+            }
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,292 @@
+/*
+ * SampleCache.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstdlib>
+
+#if defined(__linux__) || defined(__FreeBSD__) || \
+    defined(__NetBSD__) || defined(__OpenBSD__)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#define HAVE_MMAP 1
+#endif
+
+
+#pragma once
+
+#ifndef SAMPLECACHE_H
+#define SAMPLECACHE_H
+
+/****************************************************************
+        class SampleCache - keep decoded and resampled sample data
+                            on disk, a entry is keyed by the file path,
+                            modification time, size and sample rate,
+                            the raw float data start page aligned,
+                            so a cached file could be mapped directly
+****************************************************************/
+
+// max size (in bytes) of all cache entries together
+#define SAMPLE_CACHE_SIZE ((uint64_t)4 * 1024 * 1024 * 1024)
+// offset of the sample data in a cache entry
+#define SAMPLE_CACHE_DATA_OFFSET 4096
+// cache entry format version
+#define SAMPLE_CACHE_VERSION 1
+// frames interleaved per write when planar samples are stored
+#define SAMPLE_CACHE_CHUNK 65536
+
+class SampleCache {
+public:
+    // a cache entry found on disk
+    struct Entry {
+        void* base;
+        size_t size;
+        float* samples;
+        uint32_t channels;
+        uint32_t frames;
+        uint32_t samplerate;
+        bool mapped;
+    };
+
+    SampleCache(std::string name) {
+        if (getenv("XDG_CACHE_HOME")) {
+            std::string path = getenv("XDG_CACHE_HOME");
+            cache_dir = path + "/" + name;
+        } else {
+        #if defined(__linux__) || defined(__FreeBSD__) || \
+            defined(__NetBSD__) || defined(__OpenBSD__)
+            std::string path = getenv("HOME") ? getenv("HOME") : "/tmp";
+            cache_dir = path + "/.cache/" + name;
+        #else
+            std::string path = getenv("APPDATA") ? getenv("APPDATA") : ".";
+            cache_dir = path + "\\.cache\\" + name;
+        #endif
+        }
+    }
+
+    // load the cache entry for file at samplerate, map it when possible
+    bool load(const char* file, uint32_t samplerate, Entry* entry) {
+        Header key;
+        std::string path;
+        uint64_t id;
+        if (!makeKey(file, samplerate, &key, &path, &id)) return false;
+        std::string cache = entryName(id);
+        std::error_code ec;
+        if (!std::filesystem::exists(cache, ec)) return false;
+        Header head;
+        std::ifstream in(cache, std::ios::binary);
+        if (!in.read((char*)&head, sizeof(Header))) return false;
+        std::string stored(head.pathLength, '\0');
+        if (!matches(head, key) || !in.read(&stored[0], head.pathLength) || stored != path) return false;
+        in.close();
+        const uint64_t length = (uint64_t)head.frames * head.channels * sizeof(float);
+        if (std::filesystem::file_size(cache, ec) < SAMPLE_CACHE_DATA_OFFSET + length || ec) return false;
+        // mark the entry as recently used
+        std::filesystem::last_write_time(cache, std::filesystem::file_time_type::clock::now(), ec);
+        entry->channels = head.channels;
+        entry->frames = head.frames;
+        entry->samplerate = head.sourceRate;
+        #ifdef HAVE_MMAP
+        int fd = open(cache.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+        size_t size = SAMPLE_CACHE_DATA_OFFSET + length;
+        void* base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) return false;
+        posix_madvise(base, size, POSIX_MADV_WILLNEED);
+        entry->base = base;
+        entry->size = size;
+        entry->samples = (float*)((char*)base + SAMPLE_CACHE_DATA_OFFSET);
+        entry->mapped = true;
+        #else
+        try {
+            entry->samples = new float[(size_t)head.frames * head.channels];
+        } catch (...) {
+            return false;
+        }
+        in.open(cache, std::ios::binary);
+        in.seekg(SAMPLE_CACHE_DATA_OFFSET);
+        if (!in.read((char*)entry->samples, length)) {
+            delete[] entry->samples;
+            return false;
+        }
+        entry->base = nullptr;
+        entry->size = 0;
+        entry->mapped = false;
+        #endif
+        return true;
+    }
+
+    // write a cache entry, the file is written to a unique temp file first
+    // and renamed in one step, so a reader never see a half written entry,
+    // and other instances writing the same entry don't mix in, planar samples
+    // get interleaved, a entry is always stored interleaved
+    bool store(const char* file, uint32_t samplerate, const float* samples,
+                        uint32_t channels, uint32_t frames, uint32_t sourceRate,
+                        bool planar = false) {
+        Header head;
+        std::string path;
+        uint64_t id;
+        if (!samples || !frames || !makeKey(file, samplerate, &head, &path, &id)) return false;
+        head.channels = channels;
+        head.frames = frames;
+        head.sourceRate = sourceRate;
+        std::error_code ec;
+        std::filesystem::create_directories(cache_dir, ec);
+        if (ec) return false;
+        const uint64_t length = (uint64_t)frames * channels * sizeof(float);
+        trim(SAMPLE_CACHE_DATA_OFFSET + length);
+        std::string cache = entryName(id);
+        std::string temp;
+        if (!tempName(cache, &temp)) return false;
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        std::vector<char> page(SAMPLE_CACHE_DATA_OFFSET, 0);
+        std::memcpy(&page[0], &head, sizeof(Header));
+        std::memcpy(&page[sizeof(Header)], path.data(), head.pathLength);
+        out.write(page.data(), page.size());
+        if (planar) {
+            std::vector<float> chunk((size_t)SAMPLE_CACHE_CHUNK * channels);
+            for (uint32_t i = 0; i < frames && out; ) {
+                const uint32_t n = std::min<uint32_t>(frames - i, SAMPLE_CACHE_CHUNK);
+                for (uint32_t c = 0; c < channels; c++)
+                    for (uint32_t k = 0; k < n; k++)
+                        chunk[(size_t)k * channels + c] = samples[(size_t)c * frames + i + k];
+                out.write((const char*)chunk.data(), (uint64_t)n * channels * sizeof(float));
+                i += n;
+            }
+        } else {
+            out.write((const char*)samples, length);
+        }
+        out.close();
+        if (!out) {
+            std::remove(temp.c_str());
+            std::cerr << "Error: could not write sample cache " << cache << std::endl;
+            return false;
+        }
+        // rename replace a existing entry at once
+        std::filesystem::rename(temp, cache, ec);
+        if (ec) {
+            std::remove(temp.c_str());
+            return false;
+        }
+        return true;
+    }
+
+private:
+    std::string cache_dir;
+
+    // create a empty temp file next to the entry, with a name no other
+    // writer use
+    bool tempName(const std::string& cache, std::string* temp) {
+        #ifdef HAVE_MMAP
+        std::string name = cache + "XXXXXX";
+        int fd = mkstemp(&name[0]);
+        if (fd < 0) return false;
+        close(fd);
+        *temp = name;
+        #else
+        std::random_device rd;
+        *temp = cache + std::to_string(rd()) + std::to_string(rd()) + "temp";
+        #endif
+        return true;
+    }
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t channels;
+        uint32_t samplerate;
+        uint32_t frames;
+        int64_t mtime;
+        uint64_t fileSize;
+        uint32_t pathLength;
+        uint32_t sourceRate;
+    };
+
+    // collect what identify the decoded data of a file
+    bool makeKey(const char* file, uint32_t samplerate, Header* key, std::string* path, uint64_t* id) {
+        std::error_code ec;
+        std::filesystem::path p = std::filesystem::absolute(file, ec);
+        if (ec) return false;
+        auto mtime = std::filesystem::last_write_time(p, ec);
+        if (ec) return false;
+        uint64_t size = std::filesystem::file_size(p, ec);
+        if (ec) return false;
+        *path = p.string();
+        if (path->size() > SAMPLE_CACHE_DATA_OFFSET - sizeof(Header)) return false;
+        std::memset(key, 0, sizeof(Header));
+        std::memcpy(key->magic, "ALCACHE", 8);
+        key->version = SAMPLE_CACHE_VERSION;
+        key->samplerate = samplerate;
+        key->mtime = (int64_t)mtime.time_since_epoch().count();
+        key->fileSize = size;
+        key->pathLength = (uint32_t)path->size();
+        *id = 1469598103934665603ULL;
+        addHash(id, path->data(), path->size());
+        addHash(id, &key->mtime, sizeof(key->mtime));
+        addHash(id, &key->fileSize, sizeof(key->fileSize));
+        addHash(id, &key->samplerate, sizeof(key->samplerate));
+        return true;
+    }
+
+    // compare a stored header with the key
+    bool matches(const Header& head, const Header& key) const {
+        return !std::memcmp(head.magic, key.magic, 8) && head.version == key.version &&
+            head.samplerate == key.samplerate && head.mtime == key.mtime &&
+            head.fileSize == key.fileSize && head.pathLength == key.pathLength &&
+            head.channels && head.channels <= 2;
+    }
+
+    // FNV-1a hash over the key
+    static void addHash(uint64_t* hash, const void* data, size_t size) {
+        const unsigned char* d = (const unsigned char*)data;
+        for (size_t i = 0; i < size; i++) {
+            *hash ^= d[i];
+            *hash *= 1099511628211ULL;
+        }
+    }
+
+    // the cache file name for a key hash
+    std::string entryName(uint64_t id) const {
+        char name[32];
+        snprintf(name, sizeof(name), "%016llx.cache", (unsigned long long)id);
+        return (std::filesystem::path(cache_dir) / name).string();
+    }
+
+    // remove the least recently used entries until the new one fit
+    void trim(uint64_t needed) {
+        std::error_code ec;
+        std::vector<std::pair<std::filesystem::file_time_type, std::filesystem::path> > entries;
+        uint64_t total = needed;
+        for (auto& e : std::filesystem::directory_iterator(cache_dir, ec)) {
+            if (e.path().extension() != ".cache") continue;
+            total += e.file_size(ec);
+            entries.push_back({e.last_write_time(ec), e.path()});
+        }
+        if (total <= SAMPLE_CACHE_SIZE) return;
+        std::sort(entries.begin(), entries.end());
+        for (auto& e : entries) {
+            if (total <= SAMPLE_CACHE_SIZE) break;
+            total -= std::min<uint64_t>(total, std::filesystem::file_size(e.second, ec));
+            std::filesystem::remove(e.second, ec);
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,211 @@
+/*
+ * SampleConvert.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+
+#pragma once
+
+#ifndef SAMPLECONVERT_H
+#define SAMPLECONVERT_H
+
+/****************************************************************
+        class SampleConvert - copy interleaved frames into planar
+                              float buffers, forward or backward,
+                              and convert 16 bit samples to float
+                              block wise (SSE2 when available),
+                              float runs use kernels specialized for
+                              the direction and the channel layout,
+                              planar storage is copied per channel
+****************************************************************/
+
+// scale from 16 bit integer to float
+#define SAMPLE_SCALE_16 (1.0f / 32768.0f)
+
+class SampleConvert {
+public:
+
+    // copy float frames, pos count in frames, backwards read pos, pos-1, ..
+    // the kernel for the direction and the channel layout is picked once
+    static inline void planar(const float* src, uint32_t channels, uint32_t pos,
+            uint32_t frames, bool backwards, float *const *dest, uint32_t offset,
+            uint32_t chan) noexcept {
+        static const FloatKernel kernels[2][3] = {
+            { &floatRun<false, 1>, &floatRun<false, 2>, &floatRun<false, 0> },
+            { &floatRun<true, 1>, &floatRun<true, 2>, &floatRun<true, 0> }
+        };
+        const uint32_t layout = (channels == chan && chan && chan <= 2) ? chan - 1 : 2;
+        kernels[backwards][layout](&src[(size_t)pos * channels], channels, frames, dest, offset, chan);
+    }
+
+    // copy frames from planar storage, channel c start at c * stride
+    static inline void fromPlanes(const float* src, uint32_t stride, uint32_t pos,
+            uint32_t frames, bool backwards, float *const *dest, uint32_t offset,
+            uint32_t chan) noexcept {
+        for (uint32_t c = 0; c < chan; c++) {
+            const float* s = &src[(size_t)c * stride + pos];
+            float* __restrict d = dest[c] + offset;
+            if (backwards) for (uint32_t i = 0; i < frames; i++) d[i] = *(s - i);
+            else std::memcpy(d, s, frames * sizeof(float));
+        }
+    }
+
+    // convert 16 bit frames to float
+    static inline void planar(const int16_t* src, uint32_t channels, uint32_t pos,
+            uint32_t frames, bool backwards, float *const *dest, uint32_t offset,
+            uint32_t chan) noexcept {
+        uint32_t done = 0;
+        if (!backwards && channels == chan) {
+            const int16_t* s = &src[(size_t)pos * channels];
+            if (channels == 2) done = stereo16(s, dest[0] + offset, dest[1] + offset, frames);
+            else if (channels == 1) done = mono16(s, dest[0] + offset, frames);
+        }
+        for (uint32_t c = 0; c < chan; c++) {
+            float* __restrict d = dest[c] + offset;
+            if (backwards) {
+                const int16_t* s = &src[(size_t)pos * channels + c];
+                for (uint32_t i = done; i < frames; i++)
+                    d[i] = (float)*(s - (size_t)i * channels) * SAMPLE_SCALE_16;
+            } else {
+                const int16_t* s = &src[(size_t)pos * channels + c];
+                for (uint32_t i = done; i < frames; i++)
+                    d[i] = (float)s[(size_t)i * channels] * SAMPLE_SCALE_16;
+            }
+        }
+    }
+
+private:
+    typedef void (*FloatKernel)(const float*, uint32_t, uint32_t, float *const *, uint32_t, uint32_t);
+
+    // copy float frames from s on, Channels is the source layout,
+    // 1 = mono, 2 = stereo, 0 = any other (channels and chan are used)
+    template <bool Backwards, uint32_t Channels>
+    static void floatRun(const float* s, uint32_t channels, uint32_t frames,
+            float *const *dest, uint32_t offset, uint32_t chan) noexcept {
+        if (Channels == 1) {
+            float* __restrict d = dest[0] + offset;
+            if (Backwards) for (uint32_t i = 0; i < frames; i++) d[i] = *(s - i);
+            else std::memcpy(d, s, frames * sizeof(float));
+        } else if (Channels == 2) {
+            float* __restrict d0 = dest[0] + offset;
+            float* __restrict d1 = dest[1] + offset;
+            if (Backwards) {
+                for (uint32_t i = stereoBackward(s, d0, d1, frames); i < frames; i++) {
+                    d0[i] = *(s - (size_t)i * 2);
+                    d1[i] = *(s - (size_t)i * 2 + 1);
+                }
+            } else {
+                for (uint32_t i = stereoForward(s, d0, d1, frames); i < frames; i++) {
+                    d0[i] = s[2 * i];
+                    d1[i] = s[2 * i + 1];
+                }
+            }
+        } else {
+            for (uint32_t c = 0; c < chan; c++) {
+                float* __restrict d = dest[c] + offset;
+                if (Backwards) {
+                    for (uint32_t i = 0; i < frames; i++) d[i] = *(s + c - (size_t)i * channels);
+                } else {
+                    for (uint32_t i = 0; i < frames; i++) d[i] = s[(size_t)i * channels + c];
+                }
+            }
+        }
+    }
+
+    // de-interleave stereo float frames, 4 frames per step,
+    // return the number of frames done
+    static inline uint32_t stereoForward(const float* s, float* d0, float* d1, uint32_t frames) noexcept {
+        uint32_t i = 0;
+        #ifdef __SSE2__
+        for (; i + 4 <= frames; i += 4) {
+            __m128 a = _mm_loadu_ps(&s[i * 2]);
+            __m128 b = _mm_loadu_ps(&s[i * 2 + 4]);
+            _mm_storeu_ps(&d0[i], _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(&d1[i], _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+        #else
+        (void) s;
+        (void) d0;
+        (void) d1;
+        (void) frames;
+        #endif
+        return i;
+    }
+
+    // de-interleave stereo float frames in reverse order, frame i is read
+    // from s - i, 4 frames per step, return the number of frames done
+    static inline uint32_t stereoBackward(const float* s, float* d0, float* d1, uint32_t frames) noexcept {
+        uint32_t i = 0;
+        #ifdef __SSE2__
+        for (; i + 4 <= frames; i += 4) {
+            // frames -i-3 -i-2 / -i-1 -i
+            __m128 a = _mm_loadu_ps(s - (size_t)(i + 3) * 2);
+            __m128 b = _mm_loadu_ps(s - (size_t)(i + 1) * 2);
+            _mm_storeu_ps(&d0[i], _mm_shuffle_ps(b, a, _MM_SHUFFLE(0, 2, 0, 2)));
+            _mm_storeu_ps(&d1[i], _mm_shuffle_ps(b, a, _MM_SHUFFLE(1, 3, 1, 3)));
+        }
+        #else
+        (void) s;
+        (void) d0;
+        (void) d1;
+        (void) frames;
+        #endif
+        return i;
+    }
+
+    // de-interleave stereo 16 bit frames, 4 frames per step,
+    // return the number of frames done
+    static inline uint32_t stereo16(const int16_t* s, float* d0, float* d1, uint32_t frames) noexcept {
+        uint32_t i = 0;
+        #ifdef __SSE2__
+        const __m128 scale = _mm_set1_ps(SAMPLE_SCALE_16);
+        for (; i + 4 <= frames; i += 4) {
+            __m128i v = _mm_loadu_si128((const __m128i*)&s[i * 2]);
+            // sign extend L0 R0 L1 R1 / L2 R2 L3 R3 to 32 bit
+            __m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+            __m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+            _mm_storeu_ps(&d0[i], _mm_mul_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)), scale));
+            _mm_storeu_ps(&d1[i], _mm_mul_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)), scale));
+        }
+        #else
+        (void) s;
+        (void) d0;
+        (void) d1;
+        (void) frames;
+        #endif
+        return i;
+    }
+
+    // convert mono 16 bit frames, 8 frames per step
+    static inline uint32_t mono16(const int16_t* s, float* d, uint32_t frames) noexcept {
+        uint32_t i = 0;
+        #ifdef __SSE2__
+        const __m128 scale = _mm_set1_ps(SAMPLE_SCALE_16);
+        for (; i + 8 <= frames; i += 8) {
+            __m128i v = _mm_loadu_si128((const __m128i*)&s[i]);
+            __m128 a = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+            __m128 b = _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+            _mm_storeu_ps(&d[i], _mm_mul_ps(a, scale));
+            _mm_storeu_ps(&d[i + 4], _mm_mul_ps(b, scale));
+        }
+        #else
+        (void) s;
+        (void) d;
+        (void) frames;
+        #endif
+        return i;
+    }
+};
+
+#endif
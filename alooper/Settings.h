@@ -0,0 +1,100 @@
+/*
+ * Settings.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+#include <map>
+#include <string>
+#include <sstream>
+#include <fstream>
+#include <iostream>
+#include <cstdint>
+#include <cstdlib>
+
+#pragma once
+
+#ifndef SETTINGS_H
+#define SETTINGS_H
+
+/****************************************************************
+    class Settings  -  read options from a rc file in the config
+                       directory, a option is stored as [Key] value,
+                       missing options get written with the defaults
+****************************************************************/
+
+class Settings
+{
+public:
+
+    Settings(std::string configFile) {
+         if (getenv("XDG_CONFIG_HOME")) {
+            std::string path = getenv("XDG_CONFIG_HOME");
+            config_file = path + "/" + configFile + "-" + ALVER + ".rc";
+        } else {
+        #if defined(__linux__) || defined(__FreeBSD__) || \
+            defined(__NetBSD__) || defined(__OpenBSD__)
+            std::string path = getenv("HOME");
+            config_file = path +"/.config/" + configFile + "-" + ALVER + ".rc";
+        #else
+            std::string path = getenv("APPDATA");
+            config_file = path +"\\.config\\" + configFile + "-" + ALVER + ".rc";
+        #endif
+       }
+       read_Settings();
+    };
+
+    // get a option as unsigned number, add it with the default when not set
+    uint32_t getUInt(std::string key, uint32_t defaultValue) {
+        auto it = options.find(key);
+        if (it != options.end()) {
+            try {
+                return static_cast<uint32_t>(std::stoul(it->second));
+            } catch (...) {
+                std::cerr << "Error: invalid value for " << key << std::endl;
+                return defaultValue;
+            }
+        }
+        options[key] = std::to_string(defaultValue);
+        save_Settings();
+        return defaultValue;
+    }
+
+private:
+    std::string config_file;
+    std::map<std::string, std::string> options;
+
+    // read all options from the rc file
+    void read_Settings() {
+        std::ifstream infile(config_file);
+        std::string line;
+        std::string key;
+        std::string value;
+        if (infile.is_open()) {
+            while (std::getline(infile, line)) {
+                std::istringstream buf(line);
+                buf >> key;
+                buf >> value;
+                if (key.size() > 2 && key.front() == '[' && key.back() == ']')
+                    options[key.substr(1, key.size() - 2)] = value;
+                key.clear();
+                value.clear();
+            }
+        }
+        infile.close();
+    }
+
+    // write all options to the rc file
+    void save_Settings() {
+        std::ofstream outfile(config_file, std::ios::trunc);
+        if (outfile.is_open()) {
+            for (auto& o : options)
+                outfile << "[" << o.first << "] " << o.second << std::endl;
+        }
+        outfile.close();
+    }
+};
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * TapeSpeed.h
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <zita-resampler/vresampler.h>
+
+
+#pragma once
+
+#ifndef TAPESPEED_H
+#define TAPESPEED_H
+
+/****************************************************************
+        class TapeSpeed - tape style varispeed, pitch and speed
+                          move together, the loop is read with a
+                          variable ratio polyphase resampler,
+                          much cheaper than the time stretcher
+****************************************************************/
+
+// half length of the interpolation filter, long enough that the
+// filter for the fastest speed still has a pass band
+#define TAPE_FILTER_LENGTH 64
+// fastest speed the anti alias filter is made for, the resampler
+// didn't read faster anyway
+#define TAPE_MAX_SPEED 16.0
+// time constant (in frames) for speed changes
+#define TAPE_SPEED_SMOOTH 256.0
+
+class TapeSpeed {
+public:
+    TapeSpeed()
+        : fifo(nullptr),
+          scratch(nullptr),
+          fill(0),
+          capacity(0),
+          maxFrames(0),
+          chan(0),
+          speed(1.0) {}
+
+    ~TapeSpeed() {
+        delete[] fifo;
+        delete[] scratch;
+    }
+
+    // allocate the buffers for blocks of up to frames, not real-time safe
+    bool setup(uint32_t channels, uint32_t frames) {
+        delete[] fifo;
+        delete[] scratch;
+        chan = channels;
+        maxFrames = frames;
+        capacity = 2 * frames;
+        fifo = new float[(size_t)capacity * chan];
+        scratch = new float[(size_t)maxFrames * chan];
+        if (vr.setup(1.0, chan, TAPE_FILTER_LENGTH) != 0) return false;
+        // faster than 1.0 the input is read with a lower cutoff,
+        // so it didn't alias
+        if (vr.set_maxstep(TAPE_MAX_SPEED) != 0) return false;
+        vr.set_rrfilt(TAPE_SPEED_SMOOTH);
+        vr.set_rratio(1.0 / speed);
+        reset();
+        return true;
+    }
+
+    // drop all frames in the pipe
+    void reset() noexcept {
+        fill = 0;
+        vr.reset();
+        // pre-fill with k/2-1 zeros, so the output start in time
+        vr.inp_count = vr.inpsize() / 2 - 1;
+        vr.inp_data = 0;
+        vr.out_count = 1;
+        vr.out_data = 0;
+        vr.process();
+    }
+
+    // set the tape speed, 2.0 play twice as fast and a octave higher,
+    // the anti alias cutoff follow the speed in octave steps
+    inline void setSpeed(double s) noexcept {
+        if (s == speed) return;
+        speed = s;
+        vr.set_rratio(1.0 / speed);
+    }
+
+    // number of input frames to get the given number of output frames
+    inline uint32_t required(uint32_t frames) const noexcept {
+        const uint32_t need = (uint32_t)std::ceil(frames * speed) + 1;
+        const uint32_t more = need > fill ? need - fill : 1;
+        return std::max<uint32_t>(1, std::min(more, capacity - fill));
+    }
+
+    // input frames held back, the output lag behind the input by them
+    inline uint32_t latency() const noexcept {
+        return fill + TAPE_FILTER_LENGTH;
+    }
+
+    // append planar input frames, frames not fitting in get dropped
+    void process(const float *const *input, uint32_t frames) noexcept {
+        frames = std::min(frames, capacity - fill);
+        float *d = &fifo[(size_t)fill * chan];
+        for (uint32_t i = 0; i < frames; i++)
+            for (uint32_t c = 0; c < chan; c++) *d++ = input[c][i];
+        fill += frames;
+    }
+
+    // resample the buffered input into planar output,
+    // return the number of frames written
+    uint32_t retrieve(float *const *output, uint32_t frames) noexcept {
+        frames = std::min(frames, maxFrames);
+        vr.inp_count = fill;
+        vr.inp_data = fifo;
+        vr.out_count = frames;
+        vr.out_data = scratch;
+        vr.process();
+        const uint32_t used = fill - vr.inp_count;
+        fill -= used;
+        if (fill && used) std::memmove(fifo, &fifo[(size_t)used * chan], (size_t)fill * chan * sizeof(float));
+        const uint32_t done = frames - vr.out_count;
+        const float *s = scratch;
+        for (uint32_t i = 0; i < done; i++)
+            for (uint32_t c = 0; c < chan; c++) output[c][i] = *s++;
+        return done;
+    }
+
+private:
+    VResampler vr;
+    float *fifo;
+    float *scratch;
+    uint32_t fill;
+    uint32_t capacity;
+    uint32_t maxFrames;
+    uint32_t chan;
+    double speed;
+};
+
+#endif
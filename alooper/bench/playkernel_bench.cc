@@ -0,0 +1,209 @@
+/*
+ * playkernel_bench.cc
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <vector>
+
+#include "SampleConvert.h"
+#include "PlayKernel.h"
+
+/****************************************************************
+        playkernel_bench - time the playback loops as they were
+                           before (one generic loop, branching per
+                           sample) against the specialized kernels
+                           of SampleConvert and PlayKernel, and check
+                           that both give the same output
+****************************************************************/
+
+// frames per block, as the stretcher get them
+#define BENCH_FRAMES ((uint32_t)4096)
+// blocks per timing run
+#define BENCH_BLOCKS ((uint32_t)20000)
+
+/****************************************************************
+        the loops as they were before the kernels
+****************************************************************/
+
+// copy float frames, one strided loop per channel
+static void oldPlanar(const float* src, uint32_t channels, uint32_t pos, uint32_t frames,
+        bool backwards, float *const *dest, uint32_t offset, uint32_t chan) {
+    for (uint32_t c = 0; c < chan; c++) {
+        float* __restrict d = dest[c] + offset;
+        const float* s = &src[(size_t)pos * channels + c];
+        if (backwards) {
+            for (uint32_t i = 0; i < frames; i++) d[i] = *(s - (size_t)i * channels);
+        } else {
+            for (uint32_t i = 0; i < frames; i++) d[i] = s[(size_t)i * channels];
+        }
+    }
+}
+
+// the gain stage, smoothed on every frame, steady or not
+static void oldOutput(float *const *out, const float* left, const float* right,
+        uint32_t frames, float gain, float* rec) {
+    const float slow = 0.0010000000000000009 * gain;
+    for (uint32_t i = 0; i < frames; i++) {
+        rec[0] = slow + 0.999 * rec[1];
+        out[0][i] = left[i] * rec[0];
+        out[1][i] = right[i] * rec[0];
+        rec[1] = rec[0];
+    }
+}
+
+// the stop fade, checking the ramp on every frame
+static uint32_t oldFadeOut(float *const *out, uint32_t frames, float& ramp, float impl) {
+    uint32_t i = 0;
+    for (; i < frames; i++) {
+        if (ramp > 0.0f) --ramp;
+        else break;
+        const float fade = std::max(0.0f, ramp) * impl;
+        out[0][i] *= fade;
+        out[1][i] *= fade;
+    }
+    return i;
+}
+
+/****************************************************************
+        helpers
+****************************************************************/
+
+// run f for BENCH_BLOCKS blocks, return nanoseconds per frame
+static double timeRun(const std::function<void()>& f) {
+    f();
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t b = 0; b < BENCH_BLOCKS; b++) f();
+    const auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double)BENCH_BLOCKS * BENCH_FRAMES);
+}
+
+// largest difference between two planar stereo blocks
+static float maxDiff(float *const *a, float *const *b, uint32_t chan, uint32_t frames) {
+    float d = 0.0f;
+    for (uint32_t c = 0; c < chan; c++)
+        for (uint32_t i = 0; i < frames; i++) d = std::max(d, std::fabs(a[c][i] - b[c][i]));
+    return d;
+}
+
+static int failed = 0;
+
+// print a result line, a case fail when the output differ more than allowed
+static void report(const char* name, double oldNs, double newNs, float diff, float allowed) {
+    const bool ok = diff <= allowed;
+    if (!ok) failed++;
+    std::printf("%-28s old %7.3f ns/frame  new %7.3f ns/frame  x%5.2f  max diff %.3g %s\n",
+        name, oldNs, newNs, oldNs / newNs, diff, ok ? "ok" : "FAIL");
+}
+
+int main() {
+    std::mt19937 gen(2025);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    // a interleaved stereo source, long enough to read backwards from the end
+    const uint32_t srcFrames = BENCH_FRAMES + 16;
+    std::vector<float> stereo((size_t)srcFrames * 2);
+    std::vector<float> mono(srcFrames);
+    for (auto& v : stereo) v = dist(gen);
+    for (auto& v : mono) v = dist(gen);
+    std::vector<float> a0(BENCH_FRAMES), a1(BENCH_FRAMES), b0(BENCH_FRAMES), b1(BENCH_FRAMES);
+    float* a[2] = { a0.data(), a1.data() };
+    float* b[2] = { b0.data(), b1.data() };
+
+    std::printf("blocks of %u frames, %u blocks per run\n", BENCH_FRAMES, BENCH_BLOCKS);
+
+    // source copy, every direction and layout
+    struct { const char* name; const float* src; uint32_t channels; bool back; } copies[] = {
+        { "copy stereo forward", stereo.data(), 2, false },
+        { "copy stereo backward", stereo.data(), 2, true },
+        { "copy mono forward", mono.data(), 1, false },
+        { "copy mono backward", mono.data(), 1, true },
+    };
+    for (auto& k : copies) {
+        const uint32_t pos = k.back ? srcFrames - 1 : 0;
+        oldPlanar(k.src, k.channels, pos, BENCH_FRAMES, k.back, a, 0, k.channels);
+        SampleConvert::planar(k.src, k.channels, pos, BENCH_FRAMES, k.back, b, 0, k.channels);
+        const float diff = maxDiff(a, b, k.channels, BENCH_FRAMES);
+        const double o = timeRun([&] { oldPlanar(k.src, k.channels, pos, BENCH_FRAMES, k.back, a, 0, k.channels); });
+        const double n = timeRun([&] { SampleConvert::planar(k.src, k.channels, pos, BENCH_FRAMES, k.back, b, 0, k.channels); });
+        report(k.name, o, n, diff, 0.0f);
+    }
+
+    // gain stage, steady and while the gain fade
+    const float* left = stereo.data();
+    const float* right = stereo.data() + srcFrames;
+    const float gain = 0.7f;
+    // the value the smoother settle at
+    float rest[2] = { 0.2f, 0.2f };
+    for (uint32_t blk = 0; blk < 64; blk++) oldOutput(a, left, right, BENCH_FRAMES, gain, rest);
+    const float settled = rest[1];
+    for (int fading = 0; fading < 2; fading++) {
+        for (int st = 1; st >= 0; st--) {
+            const float startRec = fading ? 0.2f : settled;
+            const float* r = st ? right : left;
+            float recA[2] = { startRec, startRec };
+            float recB[2] = { startRec, startRec };
+            oldOutput(a, left, r, BENCH_FRAMES, gain, recA);
+            PlayKernel::output(st, gain, recB)(b, left, r, BENCH_FRAMES, gain, recB);
+            const float diff = maxDiff(a, b, 2, BENCH_FRAMES);
+            const double o = timeRun([&] {
+                float rec[2] = { startRec, startRec };
+                oldOutput(a, left, r, BENCH_FRAMES, gain, rec);
+            });
+            const double n = timeRun([&] {
+                float rec[2] = { startRec, startRec };
+                PlayKernel::output(st, gain, rec)(b, left, r, BENCH_FRAMES, gain, rec);
+            });
+            char name[64];
+            std::snprintf(name, sizeof(name), "output %s %s", st ? "stereo" : "mono", fading ? "fading" : "steady");
+            report(name, o, n, diff, 0.0f);
+        }
+    }
+
+    // a gain fade running out, the kernel is picked per block, so the
+    // steady one take over once the smoother settled
+    {
+        float recA[2] = { 0.2f, 0.2f };
+        float recB[2] = { 0.2f, 0.2f };
+        float diff = 0.0f;
+        for (uint32_t blk = 0; blk < 16; blk++) {
+            oldOutput(a, left, right, BENCH_FRAMES, gain, recA);
+            PlayKernel::output(true, gain, recB)(b, left, right, BENCH_FRAMES, gain, recB);
+            diff = std::max(diff, maxDiff(a, b, 2, BENCH_FRAMES));
+        }
+        const double o = timeRun([&] { oldOutput(a, left, right, BENCH_FRAMES, gain, recA); });
+        const double n = timeRun([&] { PlayKernel::output(true, gain, recB)(b, left, right, BENCH_FRAMES, gain, recB); });
+        report("output fade to steady", o, n, diff, 0.0f);
+    }
+
+    // stop fade over a whole block
+    {
+        const float step = (float)BENCH_FRAMES;
+        const float impl = 1.0f / step;
+        std::memcpy(a0.data(), left, BENCH_FRAMES * sizeof(float));
+        std::memcpy(a1.data(), right, BENCH_FRAMES * sizeof(float));
+        std::memcpy(b0.data(), left, BENCH_FRAMES * sizeof(float));
+        std::memcpy(b1.data(), right, BENCH_FRAMES * sizeof(float));
+        float rampA = step;
+        float rampB = step;
+        const uint32_t doneA = oldFadeOut(a, BENCH_FRAMES, rampA, impl);
+        const uint32_t doneB = PlayKernel::fadeOut(b, 0, BENCH_FRAMES, rampB, impl);
+        float diff = maxDiff(a, b, 2, BENCH_FRAMES);
+        if (doneA != doneB || rampA != rampB) diff = INFINITY;
+        const double o = timeRun([&] { float ramp = step; oldFadeOut(a, BENCH_FRAMES, ramp, impl); });
+        const double n = timeRun([&] { float ramp = step; PlayKernel::fadeOut(b, 0, BENCH_FRAMES, ramp, impl); });
+        report("fade out", o, n, diff, 0.0f);
+    }
+
+    std::printf(failed ? "FAILED\n" : "OK\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+/*
+ * resample_chunks.cc
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "CheckResample.h"
+
+/****************************************************************
+        resample_chunks - check the chunk wise conversion of
+                          CheckResample (beginResample, feedResample,
+                          endResample) against the one-shot conversion
+                          it replaced, with chunk sizes which didn't
+                          divide the ratio, interleaved and planar,
+                          the output must match bit for bit
+****************************************************************/
+
+// the one-shot conversion, as CheckResample::process() did it before
+static std::vector<float> oneShot(int32_t fs_inp, uint32_t ilen, const float *input,
+                                    uint32_t chan, int32_t fs_outp) {
+    uint32_t a = fs_inp, b = fs_outp;
+    while (b) { uint32_t t = a % b; a = b; b = t; }
+    const uint32_t ratio_a = fs_inp / a;
+    const uint32_t ratio_b = fs_outp / a;
+    Resampler r;
+    if (r.setup(fs_inp, fs_outp, chan, 32) != 0) return {};
+    const int32_t k = r.inpsize();
+    r.inp_count = k/2-1;
+    r.inp_data = 0;
+    r.out_count = 1;
+    r.out_data = 0;
+    r.process();
+    const uint32_t nout = (uint32_t)(((uint64_t)ilen * ratio_b + ratio_a - 1) / ratio_a);
+    std::vector<float> out((size_t)nout * chan);
+    r.inp_count = ilen;
+    r.inp_data = const_cast<float*>(input);
+    r.out_count = nout;
+    r.out_data = out.data();
+    r.process();
+    r.inp_data = 0;
+    r.inp_count = k/2;
+    r.process();
+    out.resize((size_t)(nout - r.out_count) * chan);
+    return out;
+}
+
+int main() {
+    static const uint32_t rates[][2] = { {44100, 48000}, {48000, 44100}, {22050, 48000}, {96000, 44100} };
+    static const uint32_t chunks[] = { 1, 7, 333, 4097, 10007 };
+    std::mt19937 gen(2025);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    int failed = 0;
+    for (auto& rate : rates) {
+        for (uint32_t chan = 1; chan <= 2; chan++) {
+            const uint32_t ilen = 60001;
+            std::vector<float> input((size_t)ilen * chan);
+            for (auto& v : input) v = dist(gen);
+            const std::vector<float> ref = oneShot(rate[0], ilen, input.data(), chan, rate[1]);
+            const uint32_t refFrames = ref.size() / chan;
+            for (int planar = 0; planar < 2; planar++) {
+                for (uint32_t chunk : chunks) {
+                    CheckResample cr;
+                    uint32_t olen = 0;
+                    float *out = cr.beginResample(rate[0], ilen, chan, rate[1], &olen, 32, planar);
+                    if (!out) {
+                        std::printf("FAIL %u -> %u could not start\n", rate[0], rate[1]);
+                        failed++;
+                        continue;
+                    }
+                    for (uint32_t i = 0; i < ilen; i += chunk)
+                        cr.feedResample(&input[(size_t)i * chan], std::min(chunk, ilen - i));
+                    const uint32_t done = cr.endResample();
+                    // the planar output hold channel c at c * olen
+                    bool same = done == refFrames;
+                    for (uint32_t i = 0; same && i < done; i++)
+                        for (uint32_t c = 0; c < chan; c++) {
+                            const float v = planar ? out[(size_t)c * olen + i] : out[(size_t)i * chan + c];
+                            same = same && std::memcmp(&v, &ref[(size_t)i * chan + c], sizeof(float)) == 0;
+                        }
+                    if (!same) {
+                        std::printf("FAIL %u -> %u %u channel(s) %s chunk %u: %u frames, one-shot %u\n",
+                            rate[0], rate[1], chan, planar ? "planar" : "interleaved", chunk, done, refFrames);
+                        failed++;
+                    }
+                    delete[] out;
+                }
+            }
+            std::printf("%6u -> %6u %u channel(s), %u frames checked\n", rate[0], rate[1], chan, refFrames);
+        }
+    }
+    std::printf(failed ? "FAILED\n" : "OK\n");
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,108 @@
+/*
+ * resample_segments.cc
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "CheckResample.h"
+
+/****************************************************************
+        resample_segments - check that the segments resampled each
+                            with its own Resampler (resampleSegment)
+                            stitch to the output of a single run over
+                            the whole input, the input is split as
+                            AudioFile::readResampledSegmented() do it,
+                            the output must match bit for bit
+****************************************************************/
+
+// resample the whole input in one run, return the frames written
+static uint32_t singleRun(const uint32_t *rate, std::vector<float>& input, uint32_t ilen,
+                            uint32_t chan, std::vector<float>& dest) {
+    CheckResample cr;
+    uint32_t olen = 0;
+    float *out = cr.beginResample(rate[0], ilen, chan, rate[1], &olen, 32);
+    if (!out) return 0;
+    for (uint32_t i = 0; i < ilen; i += 4096)
+        cr.feedResample(&input[(size_t)i * chan], std::min<uint32_t>(4096, ilen - i));
+    const uint32_t done = cr.endResample();
+    dest.assign(out, out + (size_t)olen * chan);
+    delete[] out;
+    return done;
+}
+
+// resample the input in segments, return the frames written in a row
+static uint32_t segmentRun(const uint32_t *rate, std::vector<float>& input, uint32_t ilen,
+                            uint32_t chan, uint32_t segments, uint32_t chunk, std::vector<float>& dest) {
+    CheckResample cr;
+    uint32_t olen = 0;
+    float *out = cr.beginResample(rate[0], ilen, chan, rate[1], &olen, 32);
+    if (!out) return 0;
+    const uint64_t a = cr.ratioIn();
+    const uint64_t history = cr.segmentHistory();
+    // input frames per segment, rounded up to the ratio step
+    const uint64_t inLength = ((ilen + segments - 1) / segments + a - 1) / a * a;
+    segments = (ilen + inLength - 1) / inLength;
+    const uint64_t segLength = inLength / a * cr.ratioOut();
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < segments; i++) {
+        const uint64_t outFrom = i * segLength;
+        const uint32_t outFrames = (uint32_t)std::min<uint64_t>(segLength, olen - outFrom);
+        // the reader deliver the input from the start of the history on
+        uint64_t pos = i ? i * inLength - history : 0;
+        const uint32_t done = cr.resampleSegment(i * inLength, outFrames, i == segments - 1, chunk,
+            [&] (float *buffer, uint32_t frames) {
+                const uint32_t n = (uint32_t)std::min<uint64_t>(frames, ilen - std::min<uint64_t>(pos, ilen));
+                std::memcpy(buffer, &input[pos * chan], (size_t)n * chan * sizeof(float));
+                pos += n;
+                return n;
+            },
+            [] (uint32_t) {});
+        total += done;
+        if (done != outFrames) break;
+    }
+    cr.closeResample();
+    dest.assign(out, out + (size_t)olen * chan);
+    delete[] out;
+    return total;
+}
+
+int main() {
+    static const uint32_t rates[][2] = { {44100, 48000}, {48000, 44100} };
+    static const uint32_t segmentCounts[] = { 2, 3, 5, 8 };
+    static const uint32_t chunks[] = { 999, 4096 };
+    std::mt19937 gen(2025);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    int failed = 0;
+    for (auto& rate : rates) {
+        for (uint32_t chan = 1; chan <= 2; chan++) {
+            const uint32_t ilen = 200003;
+            std::vector<float> input((size_t)ilen * chan);
+            for (auto& v : input) v = dist(gen);
+            std::vector<float> ref, seg;
+            const uint32_t refFrames = singleRun(rate, input, ilen, chan, ref);
+            for (uint32_t segments : segmentCounts) {
+                for (uint32_t chunk : chunks) {
+                    const uint32_t frames = segmentRun(rate, input, ilen, chan, segments, chunk, seg);
+                    const bool same = frames == refFrames && seg.size() == ref.size() &&
+                        std::memcmp(seg.data(), ref.data(), (size_t)frames * chan * sizeof(float)) == 0;
+                    if (!same) {
+                        std::printf("FAIL %u -> %u %u channel(s) %u segments chunk %u: %u frames, single run %u\n",
+                            rate[0], rate[1], chan, segments, chunk, frames, refFrames);
+                        failed++;
+                    }
+                }
+            }
+            std::printf("%6u -> %6u %u channel(s), %u frames checked\n", rate[0], rate[1], chan, refFrames);
+        }
+    }
+    std::printf(failed ? "FAILED\n" : "OK\n");
+    return failed ? 1 : 0;
+}
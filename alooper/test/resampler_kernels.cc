@@ -0,0 +1,84 @@
+/*
+ * resampler_kernels.cc
+ *
+ * SPDX-License-Identifier:  BSD-3-Clause
+ *
+ * Copyright (C) 2025 brummer <brummer@web.de>
+ */
+
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <zita-resampler/resampler.h>
+
+/****************************************************************
+        resampler_kernels - check each FIR kernel the cpu support
+                            against the scalar one, with random
+                            taps and the filter length of random
+                            conversion ratios, the vector kernels
+                            sum in other order and with FMA, so
+                            they must match within a tolerance
+****************************************************************/
+
+// the filter length Resampler::setup() use for a conversion
+static unsigned int filterLength(unsigned int fs_inp, unsigned int fs_out, unsigned int hlen) {
+    const double r = (double)fs_out / fs_inp;
+    return r < 1 ? (unsigned int)std::ceil(hlen / r) : hlen;
+}
+
+int main() {
+    static const char* names[] = { "sse", "avx2", "avx512", "neon" };
+    static const unsigned int rates[] = { 8000, 11025, 16000, 22050, 32000, 44100, 48000, 88200, 96000, 192000 };
+    std::mt19937 gen(2025);
+    std::uniform_real_distribution<float> dist(-1.0f, 1.0f);
+    std::uniform_int_distribution<unsigned int> pickRate(0, sizeof(rates) / sizeof(rates[0]) - 1);
+    std::uniform_int_distribution<unsigned int> pickHlen(8, 96);
+    const Resampler_kernel scalar = Resampler::kernel("scalar");
+    if (!scalar) {
+        std::printf("FAIL no scalar kernel\n");
+        return 1;
+    }
+    std::printf("dispatched kernel: %s\n", Resampler::kernel_name());
+    int failed = 0;
+    for (const char* name : names) {
+        const Resampler_kernel k = Resampler::kernel(name);
+        if (!k) {
+            std::printf("%-7s not supported, skipped\n", name);
+            continue;
+        }
+        double worst = 0.0;
+        unsigned int runs = 0;
+        for (unsigned int t = 0; t < 2000; t++) {
+            const unsigned int fs_inp = rates[pickRate(gen)];
+            const unsigned int fs_out = rates[pickRate(gen)];
+            // setup() refuse down sampling by more than 16
+            if (16.0 * fs_out < fs_inp) continue;
+            const unsigned int hl = filterLength(fs_inp, fs_out, pickHlen(gen));
+            std::vector<float> q1(hl), q2(hl), c1(hl), c2(hl);
+            double magnitude = 0.0;
+            for (unsigned int i = 0; i < hl; i++) {
+                q1[i] = dist(gen);
+                q2[i] = dist(gen);
+                c1[i] = dist(gen);
+                c2[i] = dist(gen);
+                magnitude += std::fabs(q1[i] * c1[i]) + std::fabs(q2[i] * c2[i]);
+            }
+            const float a = scalar(q1.data(), q2.data(), c1.data(), c2.data(), hl);
+            const float b = k(q1.data(), q2.data(), c1.data(), c2.data(), hl);
+            // the error of float sums grow with the sum of the magnitudes
+            const double error = std::fabs((double)a - b) / (magnitude + 1e-30);
+            worst = std::max(worst, error);
+            if (error > 1e-6) {
+                std::printf("FAIL %s %u -> %u hl %u: %.9g != %.9g\n", name, fs_inp, fs_out, hl, b, a);
+                failed++;
+                break;
+            }
+            runs++;
+        }
+        std::printf("%-7s %u runs, worst relative error %.3g\n", name, runs, worst);
+    }
+    std::printf(failed ? "FAILED\n" : "OK\n");
+    return failed ? 1 : 0;
+}
@@ -25,7 +25,7 @@ void free_desinterleaved_buffer(const float *const *buffer, int channel_count) {
         delete[] channels;
     }
 }
-Varispeed::Varispeed() {
+Varispeed::Varispeed() : rb(nullptr) {
     rubberband_input_buffers = allocate_desinterleaved_buffer(MAX_RUBBERBAND_CHANNELS, MAX_RUBBERBAND_BUFFER_FRAMES);
     rubberband_output_buffers = allocate_desinterleaved_buffer(MAX_RUBBERBAND_CHANNELS, MAX_RUBBERBAND_BUFFER_FRAMES);
 }
@@ -33,12 +33,36 @@ Varispeed::~Varispeed() {
     free_desinterleaved_buffer(rubberband_input_buffers, MAX_RUBBERBAND_CHANNELS);
     free_desinterleaved_buffer(rubberband_output_buffers, MAX_RUBBERBAND_CHANNELS);
 }
-void Varispeed::initialize(uint32_t sr) {
+// create a stretcher for blocks of up to MAX_RUBBERBAND_BUFFER_FRAMES
+std::unique_ptr<RubberBand::RubberBandStretcher> Varispeed::create(uint32_t sr, uint32_t channels) {
     RubberBand::RubberBandStretcher::Options rb_options = RubberBand::RubberBandStretcher::OptionProcessRealTime;
     //     | RubberBand::RubberBandStretcher::OptionEngineFiner;
+    auto s = std::make_unique<RubberBand::RubberBandStretcher>(sr, channels, rb_options);
+    s->setMaxProcessSize(MAX_RUBBERBAND_BUFFER_FRAMES);
+    return s;
+}
+void Varispeed::initialize(uint32_t sr) {
     int stereo_channel_count = 2;
-    rb = std::make_unique<RubberBand::RubberBandStretcher>(sr, stereo_channel_count, rb_options);
-    rb->setMaxProcessSize(MAX_RUBBERBAND_BUFFER_FRAMES);
-    rb->process( rubberband_input_buffers,MAX_RUBBERBAND_BUFFER_FRAMES,false);
+    for (uint32_t c = 0; c < MAX_RUBBERBAND_CHANNELS; c++) {
+        stretchers[c] = create(sr, c + 1);
+        stretchers[c]->process( rubberband_input_buffers,MAX_RUBBERBAND_BUFFER_FRAMES,false);
+        stretchers[c]->reset();
+    }
+    rb = stretchers[MAX_RUBBERBAND_CHANNELS - 1].get();
+    tape.setup(stereo_channel_count, MAX_RUBBERBAND_BUFFER_FRAMES);
+    direct.setup(stereo_channel_count, MAX_RUBBERBAND_BUFFER_FRAMES);
+}
+// get the stretcher for the given number of channels
+RubberBand::RubberBandStretcher* Varispeed::stretcher(uint32_t channels) const {
+    channels = channels < 1 ? 1 : channels > MAX_RUBBERBAND_CHANNELS ? MAX_RUBBERBAND_CHANNELS : channels;
+    return stretchers[channels - 1].get();
+}
+// switch to the stretcher for the given number of channels,
+// return true when it changed, the new one start from scratch
+bool Varispeed::select(uint32_t channels) {
+    RubberBand::RubberBandStretcher* s = stretcher(channels);
+    if (s == rb) return false;
+    rb = s;
     rb->reset();
+    return true;
 }
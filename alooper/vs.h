@@ -9,6 +9,8 @@
 
 
 #include <rubberband/RubberBandStretcher.h>
+#include "TapeSpeed.h"
+#include "DirectPath.h"
 
 #pragma once
 
@@ -22,11 +24,23 @@ class Varispeed {
    public:
     float *const *rubberband_input_buffers;
     float *const *rubberband_output_buffers;
-    std::unique_ptr<RubberBand::RubberBandStretcher> rb;
+    // the stretcher in use, sized to the channels of the played file
+    RubberBand::RubberBandStretcher* rb;
+    // tape style varispeed, used instead of the stretcher when selected
+    TapeSpeed tape;
+    // the loop played as it is, while speed and pitch are neutral
+    DirectPath direct;
 
     Varispeed();
     ~Varispeed();
     void initialize(uint32_t sr);
+    static std::unique_ptr<RubberBand::RubberBandStretcher> create(uint32_t sr, uint32_t channels);
+    RubberBand::RubberBandStretcher* stretcher(uint32_t channels) const;
+    bool select(uint32_t channels);
+
+   private:
+    // one stretcher per channel count, a mono file run on the mono one
+    std::unique_ptr<RubberBand::RubberBandStretcher> stretchers[MAX_RUBBERBAND_CHANNELS];
 };
 
 // maybe :
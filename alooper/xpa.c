@@ -18,90 +18,436 @@
 #include <condition_variable>
 #include "ParallelThread.h"
 #include "vs.h"
+#include "PlayKernel.h"
 #include "xui.h"
 #include "xpa.h"
 
 AudioLooperUi ui;
 
-// process audio in background thread
-static void processBuffer() {
-    float* out = ui.audioBuffer;
-    uint32_t frames = ui.frameSize;
-    static float fRec0[2] = {0};
-    static float ramp = 0.0;
-    static const float ramp_step = 256.0;
+// the play parameters of the current period, taken from the UI
+// at the period start, so they don't change within a period
+static PlayParams blk;
+// the last play-head move of the UI taken over
+static uint32_t seekDone = 0;
+// the play-head, owned by the worker, the UI see it at the period end
+static uint32_t playHead = 0;
+// the file played in the current period, taken at the period start
+static AudioFile* playFile = nullptr;
+// gapless play list advance: the staged file faded in over the last frames
+// of the loop, the file it follow and its loop points
+static AudioFile* incoming = nullptr;
+static AudioFile* incomingFor = nullptr;
+static uint32_t incomingL = 0;
+static uint32_t incomingR = 0;
+// the loop points of the file swapped in, used until the UI publish
+// parameters for its generation
+static bool loopOverride = false;
+static uint32_t overrideGen = 0;
+static uint32_t overrideL = 0;
+static uint32_t overrideR = 0;
+// state of the fade at the loop points
+static const uint32_t loopRampStep = 256;
+static uint32_t loopRamp = 0;
+// the cross faded seam of the loop, when it fit the loop of this period,
+// and if the last frames before the wrap came from it
+static const LoopSeam::Seam* seam = nullptr;
+static bool seamPlayed = false;
+
+// fade the frames of a run at the loop points, the run is split in the
+// part within ramp_step after the loop start (ramp up), the part
+// within ramp_step before the loop end (ramp down) and the steady
+// part between them, which is left as it is
+static inline void fadeRun(float *const *input_buffers, uint32_t offset, uint32_t run,
+                                uint32_t channel_count) {
+    uint32_t& ramp = loopRamp;
+    static const uint32_t ramp_step = loopRampStep;
     static const float ramp_impl = 1.0/ramp_step;
+    const int64_t p = playHead;
+    const int64_t l = blk.loopPoint_l;
+    const int64_t r = blk.loopPoint_r;
+    // frames of the run in the ramp up and the ramp down region
+    const int64_t up = blk.playBackwards ? p - (r - ramp_step) : (l + ramp_step) - p;
+    const int64_t down = blk.playBackwards ? p - (l + ramp_step) + 1 : (r - ramp_step) - p + 1;
+    const uint32_t a = (uint32_t)std::clamp<int64_t>(up, 0, run);
+    const uint32_t b = (uint32_t)std::clamp<int64_t>(down, a, run);
+    uint32_t c = min(channel_count, MAX_RUBBERBAND_CHANNELS);
+    if (a) {
+        for (uint32_t ch = 0; ch < c; ch++) {
+            float* d = input_buffers[ch] + offset;
+            for (uint32_t k = 0; k < a; k++)
+                d[k] *= (float)min(ramp + k + 1, ramp_step) * ramp_impl;
+        }
+        ramp = min(ramp + a, ramp_step);
+    }
+    if (b < run) {
+        const uint32_t n = run - b;
+        for (uint32_t ch = 0; ch < c; ch++) {
+            float* d = input_buffers[ch] + offset + b;
+            for (uint32_t k = 0; k < n; k++)
+                d[k] *= (float)(ramp > k + 1 ? ramp - k - 1 : 0) * ramp_impl;
+        }
+        ramp = ramp > n ? ramp - n : 0;
+    }
+}
+
+// read frames of a file, a file with less channels feed the first one to all
+static inline void readFrames(AudioFile* f, uint32_t pos, uint32_t frames, bool backwards,
+                                float *const *dest, uint32_t offset, uint32_t chan) {
+    const uint32_t fc = min(chan, f->channels);
+    f->readPlanar(pos, frames, backwards, dest, offset, fc);
+    for (uint32_t c = fc; c < chan; c++)
+        memcpy(dest[c] + offset, dest[0] + offset, frames * sizeof(float));
+}
+
+// frames of the gapless cross fade before the loop wrap
+static inline uint32_t fadeFrames() {
+    uint32_t n = ui.crossfade.size();
+    const uint32_t len = blk.loopPoint_r > blk.loopPoint_l ? blk.loopPoint_r - blk.loopPoint_l : 0;
+    n = min(n, len ? len - 1 : 0);
+    if (incoming) n = min(n, incomingR > incomingL + 1 ? incomingR - incomingL - 1 : 0);
+    return n;
+}
+
+// mix the staged file into a run, k frames into the cross fade of n frames,
+// the equal power curve is scaled when the fade is shorter than configured
+static void fadeInRun(float *const *input_buffers, uint32_t offset, uint32_t run,
+                                uint32_t k, uint32_t n, uint32_t channel_count) {
+    static float x0[MAX_RUBBERBAND_BUFFER_FRAMES];
+    static float x1[MAX_RUBBERBAND_BUFFER_FRAMES];
+    float* x[MAX_RUBBERBAND_CHANNELS] = {x0, x1};
+    uint32_t c = min(channel_count, MAX_RUBBERBAND_CHANNELS);
+    readFrames(incoming, blk.playBackwards ? incomingR - k : incomingL + k, run,
+                blk.playBackwards, x, 0, c);
+    const float* curve = ui.crossfade.data();
+    const uint64_t size = ui.crossfade.size();
+    for (uint32_t ch = 0; ch < c; ch++) {
+        float* d = input_buffers[ch] + offset;
+        for (uint32_t j = 0; j < run; j++) {
+            const uint32_t i = n == size ? k + j : (uint32_t)((uint64_t)(k + j) * size / n);
+            const uint32_t o = n == size ? n - 1 - (k + j) : (uint32_t)((uint64_t)(n - 1 - (k + j)) * size / n);
+            d[j] = d[j] * curve[o] + x[ch][j] * curve[i];
+        }
+    }
+}
+
+// swap the staged file in at the loop wrap, it play on after the frames
+// faded in, a fade once started is finished, even when the play list
+// was switched off meanwhile, return false when the loop wrap as usual
+static bool advanceLoop() {
+    if (!incoming) return false;
+    const uint32_t n = fadeFrames();
+    uint32_t gen = 0;
+    if (!ui.files.commit(playFile, incoming, gen)) {
+        ui.files.drop(incoming);
+        incoming = nullptr;
+        return false;
+    }
+    playFile = incoming;
+    incoming = nullptr;
+    loopOverride = true;
+    overrideGen = gen;
+    blk.loopPoint_l = overrideL = incomingL;
+    blk.loopPoint_r = overrideR = incomingR;
+    playHead = blk.playBackwards ? incomingR - n : incomingL + n;
+    loopRamp = loopRampStep;
+    // the seam belong to the loop before
+    seam = nullptr;
+    return true;
+}
+
+// read the next frames of the loop into the stretcher input buffers,
+// the loop is read in runs up to the next loop point, the play-head
+// wrap and the fades are handled at the edges of the runs, the runs
+// stop at the start of the loop seam and of the gapless cross fade too
+static void readLoop(float *const *input_buffers, int process_samples,
+                                uint32_t channel_count) {
+    uint32_t i = 0;
+    while (i < (uint32_t)process_samples) {
+        blk.playBackwards ? --playHead : ++playHead;
+        // check if play position excite play range
+        // if so reset play position and trigger check if new file
+        // should be loaded from play list, after the seam the
+        // play go on behind the head blended in
+        if (blk.playBackwards && playHead <= blk.loopPoint_l) {
+            if (!advanceLoop()) playHead = seamPlayed ? blk.loopPoint_r - seam->frames : blk.loopPoint_r;
+            seamPlayed = false;
+            ui.loadFile();
+        } else if (!blk.playBackwards && playHead >= blk.loopPoint_r) {
+            if (!advanceLoop()) playHead = seamPlayed ? blk.loopPoint_l + seam->frames : blk.loopPoint_l;
+            seamPlayed = false;
+            ui.loadFile();
+        }
+        // frames in a row until the next loop point
+        const uint32_t dist = blk.playBackwards ?
+            (playHead > blk.loopPoint_l ? playHead - blk.loopPoint_l : 1) :
+            (playHead < blk.loopPoint_r ? blk.loopPoint_r - playHead : 1);
+        uint32_t run = dist;
+        // the staged file is taken at the start of the cross fade
+        bool mix = false;
+        uint32_t n = 0;
+        if (blk.gapless && !ui.crossfade.empty()) {
+            n = fadeFrames();
+            uint32_t l, r;
+            if (dist == n && !incoming && (incoming = ui.files.takeStaged(l, r))) {
+                incomingFor = playFile;
+                incomingL = l;
+                incomingR = r;
+                n = fadeFrames();
+            }
+            if (dist > n) run = dist - n;
+            else mix = incoming != nullptr;
+        }
+        const bool seamed = seam && dist <= seam->frames;
+        if (seam && !seamed) run = min(run, dist - seam->frames);
+        run = min(run, (uint32_t)process_samples - i);
+        if (seamed) {
+            // the seam is already cross faded
+            const uint32_t k = seam->frames - dist;
+            for (uint32_t c = 0; c < channel_count; c++)
+                memcpy(input_buffers[c] + i, seam->data[c].data() + k, run * sizeof(float));
+            seamPlayed = true;
+        } else {
+            // copy (de-interleaved)source block wise to rubberband buffers
+            // frames not in memory (yet) play silence
+            readFrames(playFile, playHead, run, blk.playBackwards,
+                            input_buffers, i, channel_count);
+            seamPlayed = false;
+        }
+        // cross fade to the staged file, or over loop points without a seam
+        if (mix) fadeInRun(input_buffers, i, run, n - dist, n, channel_count);
+        else if (!seam) fadeRun(input_buffers, i, run, channel_count);
+        blk.playBackwards ? playHead -= run - 1 : playHead += run - 1;
+        i += run;
+    }
+}
+
+// point the input to the next frames of the loop in planar storage,
+// only when they play forward in a row without a fade, return false
+// when they must be copied by readLoop()
+static bool viewLoop(float** view, uint32_t process_samples) {
+    static const uint32_t ramp_step = loopRampStep;
+    if (blk.playBackwards) return false;
+    // the seam and the gapless cross fade are left to readLoop()
+    uint64_t tail = ramp_step;
+    if (blk.gapless && !ui.crossfade.empty()) tail = max(tail, (uint64_t)fadeFrames() + 1);
+    if (seam) tail = max(tail, (uint64_t)seam->frames + 1);
+    const uint64_t p = (uint64_t)playHead + 1;
+    if (p + process_samples > blk.loopPoint_r ||
+            p < (uint64_t)blk.loopPoint_l + ramp_step ||
+            p + process_samples + tail > (uint64_t)blk.loopPoint_r + 1) return false;
+    if (!playFile->planarView((uint32_t)p, process_samples, view, MAX_RUBBERBAND_CHANNELS)) return false;
+    playHead += process_samples;
+    return true;
+}
+
+// output frames of the stretcher still to drop after a start
+static uint32_t engineSkip = 0;
+
+// feed input frames to the stretcher or the tape engine
+static void engineProcess(bool tape, float *const *input_buffers, uint32_t frames) {
+    if (tape) ui.vs.tape.process(input_buffers, frames);
+    else ui.vs.rb->process(input_buffers, frames, false);
+}
+
+// get output frames from the stretcher or the tape engine
+static size_t engineRetrieve(bool tape, float *const *output_buffers, size_t frames) {
+    if (tape) return ui.vs.tape.retrieve(output_buffers, frames);
+    int available = ui.vs.rb->available();
+    // drop the start delay, so the output line up with the input
+    while (engineSkip && available > 0) {
+        size_t n = min((size_t)engineSkip, min((size_t)available, (size_t)MAX_RUBBERBAND_BUFFER_FRAMES));
+        ui.vs.rb->retrieve(output_buffers, n);
+        engineSkip -= n;
+        available = ui.vs.rb->available();
+    }
+    if (engineSkip || available <= 0) return 0;
+    return ui.vs.rb->retrieve(output_buffers, min((size_t)available, frames));
+}
+
+// input frames the engine hold back
+static uint32_t engineLatency(bool tape) {
+    if (tape) return ui.vs.tape.latency();
+    return ui.vs.rb->getStartDelay() + max(0, ui.vs.rb->available());
+}
+
+// start the engine new, the frames held in the direct path are fed
+// first, so that both line up for the cross fade
+static void engineStart(bool tape, float *const *input_buffers) {
+    if (tape) {
+        ui.vs.tape.reset();
+        engineSkip = 0;
+    } else {
+        ui.vs.rb->reset();
+        for (uint32_t c = 0; c < MAX_RUBBERBAND_CHANNELS; c++)
+            memset(input_buffers[c], 0, MAX_RUBBERBAND_BUFFER_FRAMES * sizeof(float));
+        size_t pad = ui.vs.rb->getPreferredStartPad();
+        while (pad) {
+            size_t n = min(pad, (size_t)MAX_RUBBERBAND_BUFFER_FRAMES);
+            ui.vs.rb->process(input_buffers, n, false);
+            pad -= n;
+        }
+        engineSkip = ui.vs.rb->getStartDelay();
+    }
+    const uint32_t pending = ui.vs.direct.pending();
+    for (uint32_t offset = 0; offset < pending; ) {
+        uint32_t n = min(pending - offset, MAX_RUBBERBAND_BUFFER_FRAMES);
+        float* frames[MAX_RUBBERBAND_CHANNELS];
+        ui.vs.direct.pendingFrames(offset, frames);
+        engineProcess(tape, frames, n);
+        offset += n;
+    }
+}
+
+// state of the start/stop fade
+static const float playRampStep = 1024.0;
+static float playRamp = playRampStep;
+static bool playDown = false;
+
+// fade in/out when start/stop the playback, the fade is applied to the
+// rendered period, once the fade out ran out the playback stop
+static void startStopFade(float *const *out, uint32_t frames) {
+    static const float ramp_impl = 1.0/playRampStep;
+    if (!blk.play && !ui.stop) {
+        const uint32_t i = PlayKernel::fadeOut(out, 0, frames, playRamp, ramp_impl);
+        if (playRamp <= 0.0f) {
+            for (uint32_t c = 0; c < 2; c++)
+                memset(out[c] + i, 0, (frames - i) * sizeof(float));
+            ui.stop = true;
+            playDown = true;
+            uint32_t reset = blk.playBackwards ? 4096 : -4096;
+            playHead += reset;
+        }
+    } else if (blk.play && playDown) {
+        PlayKernel::fadeIn(out, 0, frames, playRamp, playRampStep, ramp_impl);
+        if (playRamp >= playRampStep) playDown = false;
+    }
+}
+
+// render one period of audio
+static void renderPeriod(float *const *output, uint32_t frames) {
+    float* out[2] = {output[0], output[1]};
+    static float fRec0[2] = {0};
     float *const *rubberband_input_buffers = ui.vs.rubberband_input_buffers;
     float *const *rubberband_output_buffers = ui.vs.rubberband_output_buffers;
+    const bool tape = ui.tapeSpeed;
+    // the stretcher run only the channels the file has, the next file
+    // of a gapless play list could have more, so it stay on stereo then
+    const bool restart = ui.vs.select(blk.gapless ? MAX_RUBBERBAND_CHANNELS : playFile->channels);
 
-    ui.vs.rb->setTimeRatio(ui.timeRatio);
-    ui.vs.rb->setPitchScale(ui.pitchScale);
+    // a file kept at its native rate get corrected by the stretcher
+    const double rateCorrection = playFile->rateCorrection(ui.jack_sr);
+    if (tape) {
+        // speed and pitch move together on tape
+        ui.vs.tape.setSpeed(blk.pitchScale / (blk.timeRatio * rateCorrection));
+    } else {
+        ui.vs.rb->setTimeRatio(blk.timeRatio * rateCorrection);
+        ui.vs.rb->setPitchScale(blk.pitchScale / rateCorrection);
+    }
 
-    uint32_t source_channel_count = min(ui.af.channels,ui.vs.rb->getChannelCount());
-    uint32_t ouput_channel_count = 2;
+    // the input is filled for all channels the engine run, a file with less
+    // channels feed its first one to the others, so a gapless fade between
+    // a mono and a stereo file keep both sides, only a mono stretcher play
+    // on both output channels
+    const uint32_t channel_count = tape ? MAX_RUBBERBAND_CHANNELS : ui.vs.rb->getChannelCount();
+    const float* left = rubberband_output_buffers[0];
+    const float* right = rubberband_output_buffers[channel_count > 1 ? 1 : 0];
         
-    if (( ui.af.samplesize && ui.af.samples != nullptr) && !ui.stop && ui.ready) {
-        float fSlow0 = 0.0010000000000000009 * ui.gain;
+    if (( playFile->samplesize && playFile->isLoaded() && playFile->canPlay()) && !ui.stop && blk.ready) {
+        // with neutral speed and pitch the engine is bypassed
+        const bool neutral = blk.timeRatio == 1.0f && blk.pitchScale == 1.0f && rateCorrection == 1.0;
+        if (ui.vs.direct.select(neutral, engineLatency(tape)) ||
+                (restart && !tape && ui.vs.direct.useEngine()))
+            engineStart(tape, rubberband_input_buffers);
+        const bool useEngine = ui.vs.direct.useEngine();
+        const bool useDirect = ui.vs.direct.useDirect();
         uint32_t needed = frames;
         while (needed>0){
-            size_t available = ui.vs.rb->available();
-            if (available > 0){
-                size_t retrived_frames_count = ui.vs.rb->retrieve(rubberband_output_buffers,min(available,min(needed,MAX_RUBBERBAND_BUFFER_FRAMES)));
-                for (size_t i = 0 ; i < retrived_frames_count ;i++){
-                    fRec0[0] = fSlow0 + 0.999 * fRec0[1];
-                    for (uint32_t c = 0 ; c < ouput_channel_count ;c++){
-                        *out++ = rubberband_output_buffers[c%source_channel_count][i] * fRec0[0];
-                    }
-                    fRec0[1] = fRec0[0];
-                }
-                needed -= retrived_frames_count;
+            size_t retrived_frames_count = 0;
+            size_t want = min(needed, MAX_RUBBERBAND_BUFFER_FRAMES);
+            if (useEngine && useDirect) {
+                // cross fade, both sides deliver the same frames
+                want = min(want, (size_t)ui.vs.direct.pending());
+                retrived_frames_count = engineRetrieve(tape, rubberband_output_buffers, want);
+                ui.vs.direct.mix(rubberband_output_buffers, retrived_frames_count);
+            } else if (useDirect) {
+                retrived_frames_count = ui.vs.direct.retrieve(rubberband_output_buffers, want);
+            } else {
+                retrived_frames_count = engineRetrieve(tape, rubberband_output_buffers, want);
             }
+            // copy to the output with the (smoothed) gain
+            PlayKernel::output(channel_count > 1, blk.gain, fRec0)(
+                out, left, right, retrived_frames_count, blk.gain, fRec0);
+            out[0] += retrived_frames_count;
+            out[1] += retrived_frames_count;
+            needed -= retrived_frames_count;
             if (needed>0){
+                // the tape engine and the direct path take only what they need
                 int process_samples = min(frames, MAX_RUBBERBAND_BUFFER_FRAMES);
-                for (int i = 0 ; i < process_samples ;i++){
-                    ui.playBackwards ? --ui.position : ++ui.position;
-                    // check if play position excite play range
-                    // if so reset play position and trigger check if new file
-                    // should be loaded from play list
-                    if (ui.playBackwards && ui.position <= ui.loopPoint_l) {
-                        ui.position = ui.loopPoint_r;
-                        ui.loadFile();
-                    } else if (!ui.playBackwards && ui.position >= ui.loopPoint_r) {
-                        ui.position = ui.loopPoint_l;
-                        ui.loadFile();
-                    }
-                    // copy (de-interleaved)source to rubberband buffers
-                    for (uint32_t c = 0 ; c < source_channel_count ;c++){
-                        rubberband_input_buffers[c][i] = ui.af.samples[(ui.position * ui.af.channels) + c];
-                    }
-                    // cross fade over loop points
-                    // ramp up on loop begin point + ramp_step
-                    if (ui.playBackwards ?
-                            ui.position > ui.loopPoint_r - ramp_step :
-                            ui.position < ui.loopPoint_l + ramp_step) {
-                        if (ramp < ramp_step) ++ramp;
-                        const float fade = max(0.0,ramp) * ramp_impl ;
-                        rubberband_input_buffers[0][i] *= fade;
-                        rubberband_input_buffers[1][i] *= fade;
-                    // ramp down on loop end point - ramp_step
-                    } else if (ui.playBackwards ?
-                            ui.position < ui.loopPoint_l + ramp_step :
-                            ui.position > ui.loopPoint_r - ramp_step) {
-                        if (ramp > 0.0) --ramp;
-                        const float fade = max(0.0,ramp) * ramp_impl ;
-                        rubberband_input_buffers[0][i] *= fade;
-                        rubberband_input_buffers[1][i] *= fade;
-                    }
-                }
-                // process source with rubberband stretcher
-                ui.vs.rb->process( rubberband_input_buffers,process_samples,false);
+                if (!useEngine) process_samples = min(ui.vs.direct.required(needed), MAX_RUBBERBAND_BUFFER_FRAMES);
+                else if (tape) process_samples = min(ui.vs.tape.required(needed), MAX_RUBBERBAND_BUFFER_FRAMES);
+                // planar storage is read in place, else copied
+                float* view[MAX_RUBBERBAND_CHANNELS];
+                float *const *input = rubberband_input_buffers;
+                if (viewLoop(view, process_samples)) input = view;
+                else readLoop(rubberband_input_buffers, process_samples, channel_count);
+                // process source with rubberband stretcher or the tape engine
+                if (useEngine) engineProcess(tape, input, process_samples);
+                if (useDirect) ui.vs.direct.process(input, process_samples);
+                else ui.vs.direct.remember(input, process_samples);
             }
         }
+        playFile->setPlayHead(playHead, blk.loopPoint_l, blk.loopPoint_r, blk.playBackwards);
     } else {
         ui.vs.rb->reset();
-        memset(out, 0.0, (uint32_t)frames * 2 * sizeof(float));
+        ui.vs.tape.reset();
+        ui.vs.direct.reset();
+        for (uint32_t c = 0; c < 2; c++)
+            memset(out[c], 0.0, (uint32_t)frames * sizeof(float));
     }
-    ui.SyncWait.notify_one();
+}
+
+// process audio in background thread, render periods until the ring
+// hold the frames of prefetch depth callbacks
+static void processBuffer() {
+    const uint32_t period = ui.frameSize.load(std::memory_order_relaxed);
+    while (!ui.inSave.load(std::memory_order_acquire) && ui.ring.writable(period)) {
+        // a callback larger than a slot is rendered in several slots
+        const uint32_t frames = min(period, ui.ring.periodFrames());
+        if (!frames) break;
+        playFile = ui.files.acquire();
+        blk = ui.params.read();
+        // the staged file is given up when the loader swapped in a other file
+        if (incoming && incomingFor != playFile) {
+            ui.files.drop(incoming);
+            incoming = nullptr;
+        }
+        // a file swapped in at the loop wrap keep its loop points,
+        // until the UI publish them
+        if (loopOverride && (int32_t)(blk.fileGen - overrideGen) >= 0) loopOverride = false;
+        if (loopOverride) {
+            blk.loopPoint_l = overrideL;
+            blk.loopPoint_r = overrideR;
+        }
+        // the loop seam, when it's made for this loop, replace the fades
+        seam = ui.seam.acquire();
+        if (seam && (loopOverride || seam->gen != blk.fileGen || seam->l != blk.loopPoint_l ||
+                seam->r != blk.loopPoint_r || seam->backwards != blk.playBackwards)) seam = nullptr;
+        if (seam) loopRamp = loopRampStep;
+        else seamPlayed = false;
+        if (blk.seekCount != seekDone) {
+            seekDone = blk.seekCount;
+            playHead = blk.seekPosition;
+        }
+        // the playback start again with a fade in
+        if (blk.play && playDown) ui.stop = false;
+        float *const *out = ui.ring.writeBuffers();
+        renderPeriod(out, frames);
+        startStopFade(out, frames);
+        ui.position.store(playHead, std::memory_order_relaxed);
+        ui.ring.commit(frames);
+    }
+    // the file isn't touched until the next period start
+    ui.files.release();
 }
 
 
@@ -110,60 +456,25 @@ static int process(const void* inputBuffer, void* outputBuffer,
     unsigned long frames, const PaStreamCallbackTimeInfo* timeInfo,
     PaStreamCallbackFlags statusFlags, void* data) {
 
-    float* out = static_cast<float*>(outputBuffer);
+    // the stream is non-interleaved, one buffer per channel
+    float** out = static_cast<float**>(outputBuffer);
     (void) timeInfo;
     (void) statusFlags;
-    static const float ramp_step = 2048.0;
-    static const float ramp_impl = 1.0/ramp_step;
-    static float ramp = ramp_step;
-    static bool isDown = false;
 
     if (ui.inSave.load(std::memory_order_acquire)) {
-        memset(out, 0.0, (uint32_t)frames * 2 * sizeof(float));
-        ui.SyncWait.notify_one();
+        for (uint32_t c = 0; c < 2; c++)
+            memset(out[c], 0.0, (uint32_t)frames * sizeof(float));
         return 0;
     }
 
-    if (ui.frameSize != static_cast<uint32_t>(frames)) {
-        ui.frameSize = static_cast<uint32_t>(frames);
-        ui.getTimeOutTime.store(true, std::memory_order_release);
-    }
+    ui.frameSize.store(static_cast<uint32_t>(frames), std::memory_order_relaxed);
 
-    // get data from previous process and copy it to output
-    ui.pr.processWait();
-    memcpy(out, ui.audioBuffer, (uint32_t)frames * 2 * sizeof(float));
-
-    // fade in/out when start/stop the playback
-    if (!ui.play && !ui.stop) {
-        for(uint32_t i = 0; i < (uint32_t)frames*2; i++) {
-            if (ramp > 0.0) {
-                --ramp;
-            } else {
-                ui.stop = true;
-                isDown = true;
-                ramp = ramp_step;
-                uint32_t reset = ui.playBackwards ? 4096 : -4096;
-                ui.position += reset;
-            }
-            const float fade = max(0.0,ramp) * ramp_impl;
-            out[i] *= fade;
-        }
-    } else if (ui.play && isDown) {
-        ui.stop = false;
-        for(uint32_t i = 0; i < (uint32_t)frames*2; i++) {
-            if (ramp < ramp_step) {
-                ++ramp;
-            } else {
-                isDown = false;
-                ramp = 0.0;
-            }
-            const float fade = max(0.0,ramp) * ramp_impl;
-            out[i] *= fade;
-        }
-    }
+    // take the periods rendered ahead, when the worker run late
+    // the missing frames play silent, nothing is waited for
+    ui.ring.pop(out, static_cast<uint32_t>(frames));
 
-    // process data from current process in background
-    if (ui.pr.getProcess()) ui.pr.runProcess();
+    // wake the worker to render the next periods
+    ui.pr.runProcess();
 
     return 0;
 }
@@ -12,6 +12,8 @@
 
   silent the portaudio device probe messages
   connection preference is set to 1.) jackd, 2.) pulse audio, 3.) alsa 
+  the stream is opened non-interleaved, the callback get one buffer
+  per channel
 
 ****************************************************************/
 
@@ -83,13 +85,13 @@ public:
         PaStreamParameters inputParameters;
         inputParameters.device = it->index;
         inputParameters.channelCount = ichannels;
-        inputParameters.sampleFormat = paFloat32;
+        inputParameters.sampleFormat = paFloat32 | paNonInterleaved;
         inputParameters.hostApiSpecificStreamInfo = nullptr;
 
         PaStreamParameters outputParameters;
         outputParameters.device = it->index;
         outputParameters.channelCount = ochannels;
-        outputParameters.sampleFormat = paFloat32;
+        outputParameters.sampleFormat = paFloat32 | paNonInterleaved;
         outputParameters.hostApiSpecificStreamInfo = nullptr;
 
         bool isAlsa = strcmp(it->hostName, "ALSA") == 0 ;
@@ -113,7 +115,7 @@ public:
         PaStreamParameters inputParameters;
         inputParameters.device = Pa_GetDefaultInputDevice();
         inputParameters.channelCount = ichannels;
-        inputParameters.sampleFormat = paFloat32;
+        inputParameters.sampleFormat = paFloat32 | paNonInterleaved;
         inputParameters.suggestedLatency = 0.050;
         inputParameters.hostApiSpecificStreamInfo = nullptr;
 
@@ -121,7 +123,7 @@ public:
         outputParameters.device = Pa_GetDefaultOutputDevice();
         if (outputParameters.device == paNoDevice) return false;
         outputParameters.channelCount = ochannels;
-        outputParameters.sampleFormat = paFloat32;
+        outputParameters.sampleFormat = paFloat32 | paNonInterleaved;
         outputParameters.suggestedLatency = 0.050;
         outputParameters.hostApiSpecificStreamInfo = nullptr;
         SampleRate = info->defaultSampleRate;
@@ -26,7 +26,13 @@
 #include <cstdint>
 
 #include "PlayList.h"
+#include "Settings.h"
 #include "AudioFile.h"
+#include "PreloadCache.h"
+#include "FileSwap.h"
+#include "LoopSeam.h"
+#include "PeriodRing.h"
+#include "ParamSnapshot.h"
 #include "xwidgets.h"
 #include "xfile-dialog.h"
 #include "TextEntry.h"
@@ -123,42 +129,66 @@ public:
     ParallelThread pa;
     ParallelThread pl;
     ParallelThread pr;
-    AudioFile af;
+    // the file shown in the UI, the audio worker get it from files
+    AudioFile* af;
     Varispeed vs;
     
     uint32_t jack_sr;
-    uint32_t position;
+    // the play-head, published by the audio worker once per period
+    std::atomic<uint32_t> position;
     uint32_t loopPoint_l;
     uint32_t loopPoint_r;
-    uint32_t frameSize;
+    // the period size of the audio server, set from the process callback
+    std::atomic<uint32_t> frameSize;
+    // the last play-head move requested from the UI
+    uint32_t seekPosition;
+    uint32_t seekCount;
 
     float gain;
     float timeRatio;
     float pitchScale;
 
-    float* audioBuffer;
-    std::atomic<bool>  getTimeOutTime;
+    // the periods rendered ahead by the audio worker
+    PeriodRing ring;
+    // the play parameters as seen by the audio worker
+    ParamSnapshot params;
+    // the decoded files held in memory
+    PreloadCache preload;
+    // the file played by the audio worker
+    FileSwap files;
+    // the equal power curve of the gapless play list cross fade
+    std::vector<float> crossfade;
+    // the cross faded seam at the loop points
+    LoopSeam seam;
     std::atomic<bool>  inSave;
-    std::condition_variable SyncWait;
 
     bool loadNew;
     bool play;
     bool stop;
     bool ready;
     bool playBackwards;
-
-    AudioLooperUi() : af(), pre_af(), plist("alooper") {
+    // use the tape engine instead of the time stretcher
+    bool tapeSpeed;
+    // advance the play list gapless, with a cross fade at the loop wrap
+    bool gapless;
+    uint32_t crossfadeMs;
+    // length of the seam at the loop points, 0 fade out and in instead
+    uint32_t loopCrossfadeMs;
+    // the generation of the file shown in the UI
+    uint32_t fileGen;
+
+    AudioLooperUi() : af(), plist("alooper"), settings("alooper") {
         jack_sr = 0;
-        position = 0;
+        position.store(0, std::memory_order_relaxed);
         loopPoint_l = 0;
         loopPoint_r = 1000;
-        frameSize = 0;
+        frameSize.store(0, std::memory_order_relaxed);
         playNow = 0;
+        overviewDone = 0;
+        underrunsSeen = 0;
         gain = std::pow(1e+01, 0.05 * 0.0);
         timeRatio = 1.0;
         pitchScale = 1.0;
-        pre_load = false;
-        is_loaded = false;
         loadNew = false;
         play = true;
         stop = false;
@@ -166,21 +196,36 @@ public:
         usePlayList = false;
         forceReload = false;
         playBackwards = false;
-        audioBuffer = nullptr;
+        tapeSpeed = false;
         blockWriteToPlayList = false;
         viewPlayList = nullptr;
         stream = nullptr;
         execute.store(true, std::memory_order_release);
-        getTimeOutTime.store(false, std::memory_order_release);
         inSave.store(false, std::memory_order_release);
         plist.read_PlayList();
+        preload.setup((uint64_t)settings.getUInt("PreloadCacheMB", 1024) * 1024 * 1024,
+                                            settings.getUInt("PreloadAhead", 2));
+        AudioFile::setCompactStorage(settings.getUInt("CompactStorage", 0));
+        AudioFile::setNativeRate(settings.getUInt("NativeRate", 0));
+        AudioFile::setPlanarStorage(settings.getUInt("PlanarStorage", 0));
+        tapeSpeed = settings.getUInt("TapeVarispeed", 0);
+        gapless = settings.getUInt("Gapless", 0);
+        crossfadeMs = settings.getUInt("CrossfadeMs", 100);
+        loopCrossfadeMs = settings.getUInt("LoopCrossfadeMs", 0);
+        fileGen = 0;
+        stagedOut = false;
+        ring.setDepth(settings.getUInt("PrefetchPeriods", 2));
+        seekPosition = 0;
+        seekCount = 0;
+        publishParams();
+        af = files.get();
+        files.setCache(&preload);
     };
 
     ~AudioLooperUi() {
         pl.stop();
         pa.stop();
         pr.stop();
-        delete[] audioBuffer;
     };
 
 /****************************************************************
@@ -190,6 +235,33 @@ public:
     // set pitch scale from tuning and fine_tuning
     void setPitchScale(float tuning, float fine_tuning){        
         pitchScale = pow(2.0f, (tuning + fine_tuning / 100.0f) / 12.0f);
+        publishParams();
+    }
+
+    // hand the play parameters as a whole to the audio worker,
+    // it pick them up at the next period
+    void publishParams() {
+        PlayParams p;
+        p.gain = gain;
+        p.timeRatio = timeRatio;
+        p.pitchScale = pitchScale;
+        p.loopPoint_l = loopPoint_l;
+        p.loopPoint_r = loopPoint_r;
+        p.play = play;
+        p.playBackwards = playBackwards;
+        p.ready = ready;
+        p.seekPosition = seekPosition;
+        p.seekCount = seekCount;
+        p.gapless = gapless && usePlayList;
+        p.fileGen = fileGen;
+        params.publish(p);
+    }
+
+    // move the play-head, the audio worker own it and jump there at
+    // the next period, publish the parameters afterwards
+    void seek(uint32_t pos) {
+        seekPosition = pos;
+        seekCount++;
     }
 
     // stop background threads and quit main window
@@ -206,8 +278,13 @@ public:
         if (changed){
             vs.initialize(sr);
         }
-        audioBuffer = new float[MAX_RUBBERBAND_BUFFER_FRAMES * 2];
-        memset(audioBuffer, 0,MAX_RUBBERBAND_BUFFER_FRAMES * 2 * sizeof(float));
+        preload.setSampleRate(sr);
+        ring.setup(MAX_RUBBERBAND_BUFFER_FRAMES);
+        // sin for the fade in, read backwards (cos) for the fade out
+        crossfade.resize(gapless ? (size_t)crossfadeMs * sr / 1000 : 0);
+        for (size_t i = 0; i < crossfade.size(); i++)
+            crossfade[i] = std::sin(M_PI_2 * (i + 0.5) / crossfade.size());
+        seam.setup((uint64_t)loopCrossfadeMs * sr / 1000);
     }
 
     // receive stream object from portaudio to check 
@@ -222,7 +299,6 @@ public:
         AudioLooperUi *self = static_cast<AudioLooperUi*>(w->parent_struct);
         if (!Pa_IsStreamActive(self->stream)) return;
         if(user_data !=NULL) {
-            self->pre_load = false;
             self->blockWriteToPlayList = true;
             self->addToPlayList(*(char**)user_data, true);
             self->forceReload = true;
@@ -234,12 +310,11 @@ public:
         }
     }
 
-    // load a audio file in background process
+    // load a audio file in background process, wait-free, so the audio
+    // worker could post the loop wrap, a request while a file is loaded
+    // is dropped, the wake is kept by the thread until it wait again
     void loadFile() {
-        if (execute.load(std::memory_order_acquire)) {
-            execute.store(false, std::memory_order_release);
-            if (pl.getProcess()) pl.runProcess();
-        }
+        if (execute.exchange(false, std::memory_order_acq_rel)) pl.runProcess();
     }
 
 /****************************************************************
@@ -444,20 +519,25 @@ private:
     Widget_t *expand;
 
     SupportedFormats supportedFormats;
-    AudioFile pre_af;
     PlayList plist;
+    Settings settings;
 
     PaStream* stream;
 
-    std::mutex WMutex;
-
     uint32_t playNow;
+    uint32_t overviewDone;
+    // the underruns of the period ring already reported
+    uint32_t underrunsSeen;
+    // the copy of the overview handed to the wave view
+    std::vector<float> waveOverview;
+    // the play list entry staged for the gapless advance
+    std::string stagedFile;
+    bool stagedOut;
     bool usePlayList;
     bool forceReload;
     bool blockWriteToPlayList;
-    bool pre_load;
-    bool is_loaded;
     std::atomic<bool>  execute;
+    std::string loadedFile;
     std::string currentPlayList;
     std::string newLabel;
 
@@ -543,18 +623,32 @@ private:
     // triggered by audio server when end of current file is reached,
     // or triggered from dnd btw. a load file event (File browser)
     void loadFromPlayList() {
+        // the worker swapped in the staged entry at the loop wrap
+        if (takeSwitched() && !forceReload) {
+            prefetchNext();
+            stageNext();
+            execute.store(true, std::memory_order_release);
+            return;
+        }
         if (((plist.Play_list.size() < 2) || !usePlayList) && !forceReload) {
             execute.store(true, std::memory_order_release);
             return;
         }
+        // the staged entry is faded in at the next loop wrap
+        if (stagedOut && !forceReload) {
+            execute.store(true, std::memory_order_release);
+            return;
+        }
+        dropStaged();
         playNow++;
         plist.lfile = plist.Play_list.begin()+playNow;
         if (plist.lfile >= plist.Play_list.end()) {
             plist.lfile = plist.Play_list.begin();
             playNow = 0;
         }
-        if (!pre_load)
-            preload_soundfile(std::get<1>(*plist.lfile).c_str(), true);
+        // take the file from the pre-load cache or open it, the decoding
+        // continue after the wave view is set up
+        load_soundfile(std::get<1>(*plist.lfile).c_str());
         #if defined(__linux__) || defined(__FreeBSD__) || \
             defined(__NetBSD__) || defined(__OpenBSD__)
         XLockDisplay(w->app->dpy);
@@ -570,14 +664,89 @@ private:
         XFlush(w->app->dpy);
         XUnlockDisplay(w->app->dpy);
         #endif
-        auto it = plist.lfile + 1;
-        if (it >= plist.Play_list.end()) {
-            it = plist.Play_list.begin();
-        }
-        preload_soundfile(std::get<1>(*it).c_str(), false);
+        af->finishAudioFile();
+        prefetchNext();
+        stageNext();
         execute.store(true, std::memory_order_release);
     }
 
+    // stage the next entry of the Play List for the gapless advance,
+    // it's loaded completely with its loop points, the audio worker
+    // fade it in before the loop wrap and swap it in at the wrap
+    void stageNext() {
+        const uint32_t size = plist.Play_list.size();
+        if (!gapless || crossfade.empty() || !usePlayList || stagedOut || size < 2) return;
+        const auto& entry = plist.Play_list[(playNow + 1) % size];
+        const std::string& file = std::get<1>(entry);
+        AudioFile* next = new AudioFile();
+        // the prefetch just requested it, take it over from the loader
+        if (!preload.claim(file, *next) && !next->getAudioFile(file.c_str(), jack_sr)) {
+            delete next;
+            return;
+        }
+        const uint32_t r = min(std::get<3>(entry), next->samplesize);
+        const uint32_t l = std::get<2>(entry);
+        if (!next->isLoaded() || l + 1 >= r) {
+            delete next;
+            return;
+        }
+        // let a disk stream fetch the frames around the loop start
+        next->setPlayHead(playBackwards ? r : l, l, r, playBackwards);
+        stagedFile = file;
+        stagedOut = true;
+        files.stage(next, l, r);
+    }
+
+    // take back the staged entry before a other file is loaded,
+    // when the worker hold it, it's dropped by the worker
+    void dropStaged() {
+        if (!stagedOut) return;
+        stagedOut = false;
+        if (AudioFile* s = files.unstage()) {
+            preload.put(stagedFile, *s);
+            delete s;
+        }
+    }
+
+    // check if the worker swapped in the staged entry, when so take over
+    // the Play List position and show the file, the play-head stay with
+    // the worker
+    bool takeSwitched() {
+        AudioFile* next = files.get();
+        if (next == af) return false;
+        stagedOut = false;
+        // the Play List may be edited since the entry was staged,
+        // a entry selected meanwhile is loaded afterwards
+        const uint32_t size = plist.Play_list.size();
+        uint32_t at = playNow;
+        for (uint32_t i = 1; i <= size; i++) {
+            if (std::get<1>(plist.Play_list[(playNow + i) % size]) == stagedFile) {
+                at = (playNow + i) % size;
+                break;
+            }
+        }
+        if (!forceReload) playNow = at;
+        plist.lfile = plist.Play_list.begin() + at;
+        #if defined(__linux__) || defined(__FreeBSD__) || \
+            defined(__NetBSD__) || defined(__OpenBSD__)
+        XLockDisplay(w->app->dpy);
+        #endif
+        files.retire(af, loadedFile);
+        af = next;
+        loadedFile = stagedFile;
+        fileGen = files.generation();
+        blockWriteToPlayList = true;
+        listbox_set_active_entry(playList, at);
+        read_soundfile(stagedFile.c_str(), true, true);
+        blockWriteToPlayList = false;
+        #if defined(__linux__) || defined(__FreeBSD__) || \
+            defined(__NetBSD__) || defined(__OpenBSD__)
+        XFlush(w->app->dpy);
+        XUnlockDisplay(w->app->dpy);
+        #endif
+        return true;
+    }
+
 /****************************************************************
             PlayList - callbacks
 ****************************************************************/
@@ -605,7 +774,7 @@ private:
         plist.Play_list.erase(plist.Play_list.begin() + v);
         rebuildPlayList();
         forceReload = true;
-        pre_load = false;
+        prefetchNext();
     }
 
     // move a file in the Play List from index to index
@@ -614,7 +783,7 @@ private:
         plist.move(plist.Play_list, from, to);
         rebuildPlayList();
         forceReload = true;
-        pre_load = false;
+        prefetchNext();
     }
 
     // callback from listbox that a file is to be moved
@@ -632,7 +801,6 @@ private:
             int *v = static_cast<int*>(user_data);
             if (x1 > 0 && y1 > 0 && x1 < self->w->width && y1 < self->w->height) {
                 self->playNow = *v > 0? *v-1 : self->plist.Play_list.size()-1;
-                self->pre_load = false;
                 self->forceReload = true;
                 self->loadFile();
             } else if (x2 > 0 && y2 > 0 && x2 < w->width && y2 < w->height) {
@@ -656,7 +824,6 @@ private:
             dndfile = strtok(*(char**)user_data, "\r\n");
             while (dndfile != NULL) {
                 if (self->supportedFormats.isSupported(dndfile) ) {
-                    self->pre_load = false;
                     self->addToPlayList(dndfile, false);
                     self->forceReload = true;
                     if (self->plist.Play_list.size()<2)
@@ -702,7 +869,7 @@ private:
             if (!up) return;
             std::swap(self->plist.Play_list[up-1],self->plist.Play_list[up]);
             self->rebuildPlayList();
-            self->pre_load = false;
+            self->prefetchNext();
         }
     }
 
@@ -716,7 +883,7 @@ private:
             if (down > static_cast<int>(self->plist.Play_list.size()-1)) return;
             std::swap(self->plist.Play_list[down],self->plist.Play_list[down+1]);
             self->rebuildPlayList();
-            self->pre_load = false;
+            self->prefetchNext();
         }
     }
 
@@ -730,18 +897,17 @@ private:
         self->rebuildPlayList();
         self->currentPlayList = self->plist.PlayListNames[v];
         if (!self->plist.Play_list.size()) return;
-        if (!self->af.samples) {
+        if (!self->af->isLoaded()) {
             self->plist.lfile = self->plist.Play_list.begin();
             self->playNow = self->plist.Play_list.size();
             if (self->usePlayList) {
                 self->ready = false;
+                self->publishParams();
                 self->loadFile();
             }
         } else {
             self->playNow = self->plist.Play_list.size()-1;
-            self->pre_load = false;
-            delete[] self->pre_af.samples;
-            self->pre_af.samples = nullptr;
+            self->prefetchNext();
         }
     }
 
@@ -839,31 +1005,68 @@ private:
     void processSaveBuffer(std::string lname) {
         inSave.store(true, std::memory_order_release);
         uint32_t saveSize = loopPoint_r - loopPoint_l;
-        af.saveBuffer = new float[(int)(saveSize*timeRatio)*af.channels +2];
-        memset(af.saveBuffer, 0, 2+ (int)(saveSize*timeRatio)*af.channels*sizeof(float));
-        float* out = af.saveBuffer;
+        // a file at native rate get stretched to the session rate
+        const double rateCorrection = af->rateCorrection(jack_sr);
+        const double saveRatio = timeRatio * rateCorrection;
+        // on tape the pitch change the length too
+        const double tapeRatio = saveRatio / pitchScale;
+        const uint32_t saveFrames = (uint32_t)(saveSize * (tapeSpeed ? tapeRatio : saveRatio));
+        af->saveBuffer = new float[saveFrames*af->channels +2];
+        memset(af->saveBuffer, 0, 2+ saveFrames*af->channels*sizeof(float));
+        float* out = af->saveBuffer;
         static float fRec0[2] = {0};
-        float *const *rubberband_input_buffers = vs.rubberband_input_buffers;
-        float *const *rubberband_output_buffers = vs.rubberband_output_buffers;
-        vs.rb->reset();
-        vs.rb->setTimeRatio(timeRatio);
-        vs.rb->setPitchScale(pitchScale);
-        vs.rb->process( rubberband_input_buffers,MAX_RUBBERBAND_BUFFER_FRAMES,false);
-        uint32_t offset = vs.rb->getPreferredStartPad()+2;
-        uint32_t source_channel_count = min(af.channels,vs.rb->getChannelCount());
+        // the save is rendered with its own engines and buffers,
+        // so the state of the audio worker stay as it is
+        std::vector<float> saveInput[MAX_RUBBERBAND_CHANNELS];
+        std::vector<float> saveOutput[MAX_RUBBERBAND_CHANNELS];
+        float* inputBuffers[MAX_RUBBERBAND_CHANNELS];
+        float* outputBuffers[MAX_RUBBERBAND_CHANNELS];
+        for (uint32_t c = 0; c < MAX_RUBBERBAND_CHANNELS; c++) {
+            saveInput[c].assign(MAX_RUBBERBAND_BUFFER_FRAMES, 0.0f);
+            saveOutput[c].assign(MAX_RUBBERBAND_BUFFER_FRAMES, 0.0f);
+            inputBuffers[c] = saveInput[c].data();
+            outputBuffers[c] = saveOutput[c].data();
+        }
+        float *const *rubberband_input_buffers = inputBuffers;
+        float *const *rubberband_output_buffers = outputBuffers;
+        // a mono loop is saved with a mono stretcher
+        std::unique_ptr<RubberBand::RubberBandStretcher> rb = Varispeed::create(jack_sr,
+            std::clamp<uint32_t>(af->channels, 1, MAX_RUBBERBAND_CHANNELS));
+        TapeSpeed tape;
+        tape.setup(MAX_RUBBERBAND_CHANNELS, MAX_RUBBERBAND_BUFFER_FRAMES);
+        rb->setTimeRatio(saveRatio);
+        rb->setPitchScale(pitchScale / rateCorrection);
+        rb->process( rubberband_input_buffers,MAX_RUBBERBAND_BUFFER_FRAMES,false);
+        uint32_t offset = rb->getPreferredStartPad()+2;
+        if (tapeSpeed) {
+            tape.setSpeed(1.0 / tapeRatio);
+            tape.reset();
+            offset = 0;
+        }
+        uint32_t source_channel_count = min(af->channels,rb->getChannelCount());
         uint32_t needed = saveSize;
         uint32_t processed = loopPoint_l;
         uint32_t outSize = 0;
         size_t run = 1;
         float fSlow0 = 0.0010000000000000009 * gain;
+        float* streamBuffer = af->stream ? new float[MAX_RUBBERBAND_BUFFER_FRAMES * af->channels] : nullptr;
         while (run>0){
-            vs.rb->setTimeRatio(timeRatio);
-            vs.rb->setPitchScale(pitchScale);
-            size_t available = vs.rb->available();
-            run = available;
+            size_t available = 0;
+            if (tapeSpeed) {
+                // the tape engine deliver what the buffered input give
+                available = min(saveFrames - min(outSize, saveFrames), MAX_RUBBERBAND_BUFFER_FRAMES);
+                available = tape.retrieve(rubberband_output_buffers, available);
+                run = available + needed;
+            } else {
+                rb->setTimeRatio(saveRatio);
+                rb->setPitchScale(pitchScale / rateCorrection);
+                available = rb->available();
+                run = available;
+            }
             if (available > 0){
-                size_t retrived_frames_count = vs.rb->retrieve(rubberband_output_buffers,min(available,min(needed,MAX_RUBBERBAND_BUFFER_FRAMES)));
-                if (!needed) retrived_frames_count = vs.rb->retrieve(rubberband_output_buffers,min(available,MAX_RUBBERBAND_BUFFER_FRAMES));
+                size_t retrived_frames_count = available;
+                if (!tapeSpeed) retrived_frames_count = rb->retrieve(rubberband_output_buffers,min(available,min(needed,MAX_RUBBERBAND_BUFFER_FRAMES)));
+                if (!tapeSpeed && !needed) retrived_frames_count = rb->retrieve(rubberband_output_buffers,min(available,MAX_RUBBERBAND_BUFFER_FRAMES));
                 for (size_t i = 0 ; i < retrived_frames_count ;i++){
                     if (offset > 0) {
                         offset--;
@@ -879,23 +1082,33 @@ private:
             }
             if (needed>0){
                 int process_samples = min(needed, MAX_RUBBERBAND_BUFFER_FRAMES);
-                for (int i = 0 ; i < process_samples ;i++){
-                    processed++;
-                    // copy (de-interleaved)source to rubberband buffers
-                    for (uint32_t c = 0 ; c < source_channel_count ;c++){
-                        rubberband_input_buffers[c][i] = af.samples[(processed * af.channels) + c];
+                if (tapeSpeed) process_samples = min((uint32_t)process_samples,
+                                    tape.required(MAX_RUBBERBAND_BUFFER_FRAMES));
+                // a streamed file is read block wise from disk
+                if (af->stream) {
+                    af->stream->read(processed + 1, streamBuffer, process_samples);
+                    for (int i = 0 ; i < process_samples ;i++){
+                        // copy (de-interleaved)source to rubberband buffers
+                        for (uint32_t c = 0 ; c < source_channel_count ;c++){
+                            rubberband_input_buffers[c][i] = streamBuffer[(i * af->channels) + c];
+                        }
                     }
+                } else {
+                    af->readPlanar(processed + 1, process_samples, false,
+                                    rubberband_input_buffers, 0, source_channel_count);
                 }
+                processed += process_samples;
                 needed -= process_samples;
-                // process source with rubberband stretcher
-                vs.rb->process( rubberband_input_buffers,process_samples,false);
+                // process source with rubberband stretcher or the tape engine
+                if (tapeSpeed) tape.process(rubberband_input_buffers,process_samples);
+                else rb->process( rubberband_input_buffers,process_samples,false);
             }
         }
-        af.saveProcessedAudioFile(lname, outSize, jack_sr);
-        vs.rb->reset();
+        delete[] streamBuffer;
+        af->saveProcessedAudioFile(lname, outSize, jack_sr);
         inSave.store(false, std::memory_order_release);
-        delete[] af.saveBuffer;
-        af.saveBuffer = nullptr;
+        delete[] af->saveBuffer;
+        af->saveBuffer = nullptr;
     }
 
     // save a loop to file
@@ -903,10 +1116,10 @@ private:
         Widget_t *w = (Widget_t*)w_;
         if(user_data !=NULL && strlen(*(const char**)user_data)) {
             AudioLooperUi *self = static_cast<AudioLooperUi*>(w->parent_struct);
-            if (!self->af.samples) return;
+            if (!self->af->isLoaded() || self->af->inProgress()) return;
             std::string lname(*(const char**)user_data);
             self->processSaveBuffer(lname);
-            //self->af.saveAudioFile(lname, self->loopPoint_l, self->loopPoint_r, self->jack_sr);
+            //self->af->saveAudioFile(lname, self->loopPoint_l, self->loopPoint_r, self->jack_sr);
         }
     }
 
@@ -914,97 +1127,103 @@ private:
                     Sound File loading
 ****************************************************************/
 
+    // update the wave view, a streamed file, a file in progress
+    // or a file in compact or planar storage provide a overview
+    void updateWaveView() {
+        if (af->stream) {
+            af->stream->copyOverview(waveOverview);
+            update_waveview(wview, waveOverview.data(), waveOverview.size());
+        } else if (af->inProgress() || af->isCompact() || af->planar) {
+            DiskStream::copyPeaks(af->overview, waveOverview);
+            update_waveview(wview, waveOverview.data(), waveOverview.size());
+        } else {
+            update_waveview(wview, af->samples.load(std::memory_order_acquire), af->samplesize);
+        }
+    }
+
     // when Sound File loading fail, clear wave view and reset tittle
     void failToLoad() {
         loadNew = true;
-        update_waveview(wview, af.samples, af.samplesize);
+        updateWaveView();
         widget_set_title(w_top, "alooper");
     }
 
-    // pre-load a Sound File on demand
-    void preload_soundfile(const char* file, bool block_play = false) {
-        if (block_play) ready = false;
-        pre_load = pre_af.getAudioFile(file, jack_sr);
+    // request the next files from the Play List in the pre-load cache
+    void prefetchNext() {
+        std::vector<std::string> next;
+        const uint32_t size = plist.Play_list.size();
+        for (uint32_t i = 1; i <= preload.getAhead() && i < size; i++)
+            next.push_back(std::get<1>(plist.Play_list[(playNow + i) % size]));
+        preload.prefetch(next);
     }
 
-    // load a Sound File when pre-load is the wrong file
+    // load a Sound File, from the pre-load cache when it is there,
+    // the current file is handed over to the cache
     void load_soundfile(const char* file) {
-        af.channels = 0;
-        af.samplesize = 0;
-        af.samplerate = 0;
-        position = 0;
-
-        if (Pa_IsStreamActive(stream)) {
-            std::unique_lock<std::mutex> lk(WMutex);
-            SyncWait.wait_for(lk, std::chrono::milliseconds(60));
-        }
-
         ready = false;
-        is_loaded = af.getAudioFile(file, jack_sr);
-        if (!is_loaded) failToLoad();
+        seek(0);
+        publishParams();
+
+        AudioFile* next = new AudioFile();
+        if (!preload.claim(file, *next)) next->openAudioFile(file, jack_sr, true);
+        // the played file is handed to the cache once the worker let it go,
+        // the UI switch under the display lock, so the timeout see one of them
+        #if defined(__linux__) || defined(__FreeBSD__) || \
+            defined(__NetBSD__) || defined(__OpenBSD__)
+        XLockDisplay(w->app->dpy);
+        #endif
+        AudioFile* played = files.publish(next);
+        // the worker swapped in the staged entry meanwhile
+        if (played != af) files.retire(played, stagedFile);
+        files.retire(af, loadedFile);
+        af = next;
+        loadedFile = file;
+        fileGen = files.generation();
+        #if defined(__linux__) || defined(__FreeBSD__) || \
+            defined(__NetBSD__) || defined(__OpenBSD__)
+        XUnlockDisplay(w->app->dpy);
+        #endif
     }
 
-    // load Sound File data into memory
-    void read_soundfile(const char* file, bool haveLoopPoints = false) {
-        if (!pre_load) {
-            if (!is_loaded) {
-                load_soundfile(file);
-                is_loaded = false;
-            }
-        } else {
-            af.channels = 0;
-            af.samplesize = 0;
-            af.samplerate = 0;
-            position = 0;
-            if (Pa_IsStreamActive(stream)) {
-                std::unique_lock<std::mutex> lk(WMutex);
-                SyncWait.wait_for(lk, std::chrono::milliseconds(60));
-            }
-            ready = false;
-            delete[] af.samples;
-            af.samples = nullptr;
-            af.samples = pre_af.samples;
-            pre_af.samples = nullptr;
-            af.channels = pre_af.channels;
-            af.samplesize = pre_af.samplesize;
-            af.samplerate = pre_af.samplerate;
-            pre_load = false;
-            
-        }
+    // load Sound File data into memory, seamless keep the play-head,
+    // the file is swapped in by the worker then
+    void read_soundfile(const char* file, bool haveLoopPoints = false, bool seamless = false) {
         loadNew = true;
-        if (af.samples) {
-            adj_set_max_value(wview->adj, (float)af.samplesize);
-            //adj_set_max_value(loopMark_L->adj, (float)af.samplesize*0.5);
+        if (af->isLoaded()) {
+            adj_set_max_value(wview->adj, (float)af->samplesize);
+            //adj_set_max_value(loopMark_L->adj, (float)af->samplesize*0.5);
             adj_set_state(loopMark_L->adj, 0.0);
             loopPoint_l = 0;
-            //adj_set_max_value(loopMark_R->adj, (float)af.samplesize*0.5);
+            //adj_set_max_value(loopMark_R->adj, (float)af->samplesize*0.5);
             adj_set_state(loopMark_R->adj,1.0);
-            loopPoint_r = af.samplesize;
+            loopPoint_r = af->samplesize;
             if (haveLoopPoints) {
-                if (std::get<3>(*plist.lfile) > af.samplesize)
-                    std::get<3>(*plist.lfile) = af.samplesize;
+                if (std::get<3>(*plist.lfile) > af->samplesize)
+                    std::get<3>(*plist.lfile) = af->samplesize;
             }
             
-            update_waveview(wview, af.samples, af.samplesize);
+            updateWaveView();
+            overviewDone = af->waveProgress();
             char name[256];
             strncpy(name, file, 255);
             widget_set_title(w_top, basename(name));
         } else {
-            af.samplesize = 0;
+            af->samplesize = 0;
             std::cerr << "Error: could not resample file" << std::endl;
             failToLoad();
         }
-        if (playBackwards) position = af.samplesize;
-        if (haveLoopPoints) setLoopPoints();
+        if (playBackwards && !seamless) seek(af->samplesize);
+        if (haveLoopPoints) setLoopPoints(!seamless);
         ready = true;
+        publishParams();
     }
 
     // set the loop points for a new loaded file
-    void setLoopPoints() {
+    void setLoopPoints(bool moveHead = true) {
         float point_l = static_cast<float>(std::get<2>(*plist.lfile));
-        float upper_l = static_cast<float>(af.samplesize*0.5);
+        float upper_l = static_cast<float>(af->samplesize*0.5);
         float point_r = static_cast<float>(std::get<3>(*plist.lfile) - upper_l);
-        position = std::get<2>(*plist.lfile)+1;
+        if (moveHead) seek(std::get<2>(*plist.lfile)+1);
         loopPoint_l = std::get<2>(*plist.lfile);
         loopPoint_r = std::get<3>(*plist.lfile);
         adj_set_state(loopMark_L->adj, point_l/upper_l);
@@ -1025,7 +1244,6 @@ private:
             dndfile = strtok(*(char**)user_data, "\r\n");
             while (dndfile != NULL) {
                 if (self->supportedFormats.isSupported(dndfile) ) {
-                    self->pre_load = false;
                     self->forceReload = true;
                     self->addToPlayList(dndfile, true);
                     self->playNow = self->plist.Play_list.size() -2;
@@ -1055,7 +1273,25 @@ private:
         XLockDisplay(w->app->dpy);
         #endif
         wview->func.adj_callback = dummy_callback;
-        if (ready) adj_set_value(wview->adj, (float) position);
+        // redraw the wave view while the overview grows
+        if (ready && overviewDone != af->waveProgress()) {
+            overviewDone = af->waveProgress();
+            updateWaveView();
+            loadNew = true;
+        }
+        // report when the callback ran dry, the worker was to late then
+        const uint32_t underruns = ring.getUnderruns();
+        if (underruns != underrunsSeen) {
+            std::cerr << "Warning: audio worker late, " << underruns - underrunsSeen
+                      << " period(s) played partly silent" << std::endl;
+            underrunsSeen = underruns;
+        }
+        // keep the loop region of a mapped file resident
+        if (ready) af->lockRegion(loopPoint_l, loopPoint_r);
+        // render the seam when the loop changed, the file is swapped
+        // under the display lock, so it stay while the seam is made
+        if (ready) seam.render(af, fileGen, loopPoint_l, loopPoint_r, playBackwards);
+        if (ready) adj_set_value(wview->adj, (float) position.load(std::memory_order_relaxed));
         else {
             waitOne++;
             if (waitOne > 2) {
@@ -1069,10 +1305,6 @@ private:
         XFlush(w->app->dpy);
         XUnlockDisplay(w->app->dpy);
         #endif
-        if (getTimeOutTime.load(std::memory_order_acquire)) {
-            pr.setTimeOut(max(100,static_cast<int>((frameSize/(jack_sr*0.000001))*0.1)));
-            getTimeOutTime.store(false, std::memory_order_release);
-        }
         wview->func.adj_callback = transparent_draw;
     }
 
@@ -1094,6 +1326,7 @@ private:
         FileButton *filebutton = (FileButton *)w->private_struct;
         AudioLooperUi *self = static_cast<AudioLooperUi*>(w->parent_struct);
         self->play = false;
+        self->publishParams();
         if(user_data !=NULL) {
             char *tmp = strdup(*(const char**)user_data);
             free(filebutton->last_path);
@@ -1107,6 +1340,7 @@ private:
         adj_set_value(w->adj,0.0);
         if (!adj_get_value(self->paus->adj))
              self->play = true;
+        self->publishParams();
     }
 
     static void fxbutton_callback(void *w_, void* user_data) {
@@ -1198,9 +1432,11 @@ private:
         if (key->keycode == XKeysymToKeycode(w->app->dpy, XK_space)) {
             adj_set_value(self->paus->adj, !adj_get_value(self->paus->adj));
             self->play = adj_get_value(self->paus->adj) ? false : true;
+            self->publishParams();
         } else if (key->keycode == XKeysymToKeycode(w->app->dpy, XK_Left)) {
             adj_set_value(self->backwards->adj, !adj_get_value(self->backwards->adj));
             self->playBackwards = adj_get_value(self->backwards->adj) ? true : false;
+            self->publishParams();
         } else if (key->keycode == XKeysymToKeycode(w->app->dpy, XK_q)) {
             self->onExit();
         } else if ((key->state & ControlMask) && (key->keycode == XKeysymToKeycode(w->app->dpy, XK_plus))) {
@@ -1280,6 +1516,7 @@ private:
         if (adj_get_value(w->adj)){
             self->play = false;
         } else self->play = true;
+        self->publishParams();
     }
 
     // play backwards
@@ -1289,6 +1526,7 @@ private:
         if ((w->flags & HAS_POINTER) && adj_get_value(w->adj)){
             self->playBackwards = true;
         } else self->playBackwards = false;
+        self->publishParams();
     }
 
     // move playhead to start position 
@@ -1296,7 +1534,8 @@ private:
         Widget_t *w = (Widget_t*)w_;
         AudioLooperUi *self = static_cast<AudioLooperUi*>(w->parent_struct);
         if ((w->flags & HAS_POINTER) && !adj_get_value(w->adj)){
-            self->position = 0;
+            self->seek(0);
+            self->publishParams();
         }
     }
 
@@ -1305,15 +1544,17 @@ private:
         Widget_t *w = (Widget_t*)w_;
         AudioLooperUi *self = static_cast<AudioLooperUi*>(w->parent_struct);
         float st = adj_get_state(w->adj);
-        uint32_t lp = (self->af.samplesize) * st;
-        if (lp > self->position) {
-            lp = self->position;
-            st = max(0.0, min(1.0, (float)((float)self->position/(float)self->af.samplesize)));
+        uint32_t lp = (self->af->samplesize) * st;
+        const uint32_t head = self->position.load(std::memory_order_relaxed);
+        if (lp > head) {
+            lp = head;
+            st = max(0.0, min(1.0, (float)((float)head/(float)self->af->samplesize)));
         }
         adj_set_state(w->adj, st);
         int width = self->w_top->width-40;
         os_move_window(self->w->app->dpy, w, 15+ (width * st), 2);
         self->loopPoint_l = lp;
+        self->publishParams();
         if (!self->plist.Play_list.size()) return;
         if (w->flags & HAS_POINTER && !self->blockWriteToPlayList) {
             std::get<2>(*(self->plist.Play_list.begin()+self->playNow)) = self->loopPoint_l;
@@ -1345,10 +1586,11 @@ private:
         int width = self->w_top->width-40;
         int pos = max(15, min (width+15,x1-5));
         float st =  (float)( (float)(pos-15.0)/(float)width);
-        uint32_t lp = (self->af.samplesize) * st;
-        if (lp > self->position) {
-            lp = self->position;
-            st = max(0.0, min(1.0, (float)((float)self->position/(float)self->af.samplesize)));
+        uint32_t lp = (self->af->samplesize) * st;
+        const uint32_t head = self->position.load(std::memory_order_relaxed);
+        if (lp > head) {
+            lp = head;
+            st = max(0.0, min(1.0, (float)((float)head/(float)self->af->samplesize)));
         }
         adj_set_state(w->adj, st);
     }
@@ -1358,15 +1600,17 @@ private:
         Widget_t *w = (Widget_t*)w_;
         AudioLooperUi *self = static_cast<AudioLooperUi*>(w->parent_struct);
         float st = adj_get_state(w->adj);
-        uint32_t lp = (self->af.samplesize * st);
-        if (lp < self->position) {
-            lp = self->position;
-            st = max(0.0, min(1.0, (float)((float)self->position/(float)self->af.samplesize)));
+        uint32_t lp = (self->af->samplesize * st);
+        const uint32_t head = self->position.load(std::memory_order_relaxed);
+        if (lp < head) {
+            lp = head;
+            st = max(0.0, min(1.0, (float)((float)head/(float)self->af->samplesize)));
         }
         adj_set_state(w->adj, st);
         int width = self->w_top->width-40;
         os_move_window(self->w->app->dpy, w, 15 + (width * st), 2);
         self->loopPoint_r = lp;
+        self->publishParams();
         if (!self->plist.Play_list.size()) return;
         if (w->flags & HAS_POINTER && !self->blockWriteToPlayList) {
             std::get<3>(*(self->plist.Play_list.begin()+self->playNow)) = self->loopPoint_r;
@@ -1398,10 +1642,11 @@ private:
         int width = self->w_top->width-40;
         int pos = max(15, min (width+15,x1-5));
         float st =  (float)( (float)(pos-15.0)/(float)width);
-         uint32_t lp = (self->af.samplesize * st);
-        if (lp < self->position) {
-            lp = self->position;
-            st = max(0.0, min(1.0, (float)((float)self->position/(float)self->af.samplesize)));
+         uint32_t lp = (self->af->samplesize * st);
+        const uint32_t head = self->position.load(std::memory_order_relaxed);
+        if (lp < head) {
+            lp = head;
+            st = max(0.0, min(1.0, (float)((float)head/(float)self->af->samplesize)));
         }
         adj_set_state(w->adj, st);
     }
@@ -1432,7 +1677,8 @@ private:
                 uint32_t lp = adj_get_max_value(w->adj) * st;
                 if (lp > self->loopPoint_r) lp = self->loopPoint_r;
                 if (lp < self->loopPoint_l) lp = self->loopPoint_l;
-                self->position = lp;
+                self->seek(lp);
+                self->publishParams();
             }
         }
     }
@@ -1452,8 +1698,10 @@ private:
             //widget_show_all(self->viewPlayList);
             //os_move_window(self->w->app->dpy,self->viewPlayList,x1, y1+16+self->w->height);
             self->usePlayList = true;
-            if (!self->af.samples && self->plist.Play_list.size()) {
+            self->publishParams();
+            if (!self->af->isLoaded() && self->plist.Play_list.size()) {
                 self->ready = false;
+                self->publishParams();
                 self->plist.lfile = self->plist.Play_list.begin();
                 self->playNow = self->plist.Play_list.size();
                 self->loadFile();
@@ -1462,6 +1710,7 @@ private:
         } else {
             //widget_hide(self->viewPlayList);
             self->usePlayList = false;
+            self->publishParams();
         }
     }
 
@@ -1470,6 +1719,7 @@ private:
         Widget_t *w = (Widget_t*)w_;
         AudioLooperUi *self = static_cast<AudioLooperUi*>(w->parent_struct);
         self->gain = std::pow(1e+01, 0.05 * adj_get_value(w->adj));
+        self->publishParams();
     }
 
     // speed/timeRatio control
@@ -1477,6 +1727,7 @@ private:
         Widget_t *w = (Widget_t*)w_;
         AudioLooperUi *self = static_cast<AudioLooperUi*>(w->parent_struct);
         self->timeRatio = adj_get_value(w->adj);
+        self->publishParams();
     }
     
     // tuning control
@@ -1628,13 +1879,13 @@ private:
         cairo_stroke(cri);
 
         if (wave_view->size<1 || !ready) return;
-        int step = (wave_view->size/width)/af.channels;
-        float lstep = (float)(half_height_t)/af.channels;
+        int step = (wave_view->size/width)/af->channels;
+        float lstep = (float)(half_height_t)/af->channels;
         cairo_set_line_width(cri,2);
         cairo_set_source_rgba(cri, 0.55, 0.65, 0.55, 1);
 
-        int pos = half_height_t/af.channels;
-        for (int c = 0; c < (int)af.channels; c++) {
+        int pos = half_height_t/af->channels;
+        for (int c = 0; c < (int)af->channels; c++) {
             cairo_pattern_t *pat = cairo_pattern_create_linear (0, pos, 0, height);
             cairo_pattern_add_color_stop_rgba
                 (pat, 0,1.53,0.33,0.33, 1.0);
@@ -1648,7 +1899,7 @@ private:
             cairo_set_source(cri, pat);
             for (int i=0;i<width-4;i++) {
                 cairo_move_to(cri,i+2,pos);
-                float w = wave_view->wave[int(c+(i*af.channels)*step)];
+                float w = wave_view->wave[int(c+(i*af->channels)*step)];
                 cairo_line_to(cri, i+2,(float)(pos)+ (-w * lstep));
                 cairo_line_to(cri, i+2,(float)(pos)+ (w * lstep));
             }
@@ -72,6 +72,7 @@ Resampler_table::Resampler_table (double fr, unsigned int hl, unsigned int np) :
     float         *p;
 
     _ctab = new float [hl * (np + 1)];
+    _rtab = new float [hl * (np + 1)];
     p = _ctab;
     for (j = 0; j <= np; j++)
     {
@@ -79,6 +80,7 @@ Resampler_table::Resampler_table (double fr, unsigned int hl, unsigned int np) :
 	for (i = 0; i < hl; i++)
 	{
 	    p [hl - i - 1] = (float)(fr * sinc (t * fr) * wind (t / hl));
+	    _rtab [j * hl + i] = p [hl - i - 1];
 	    t += 1;
 	}
 	p += hl;
@@ -89,6 +91,7 @@ Resampler_table::Resampler_table (double fr, unsigned int hl, unsigned int np) :
 Resampler_table::~Resampler_table (void)
 {
     delete[] _ctab;
+    delete[] _rtab;
 }
 
 
@@ -24,6 +24,14 @@
 #include <math.h>
 #include <zita-resampler/resampler.h>
 
+#if !defined(RESAMPLER_NO_SIMD) && defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define RESAMPLER_X86 1
+#include <immintrin.h>
+#elif !defined(RESAMPLER_NO_SIMD) && (defined(__ARM_NEON) || defined(__aarch64__))
+#define RESAMPLER_NEON 1
+#include <arm_neon.h>
+#endif
+
 
 static unsigned int gcd (unsigned int a, unsigned int b)
 {
@@ -48,10 +56,200 @@ static unsigned int gcd (unsigned int a, unsigned int b)
 }
 
 
+// The FIR kernels. The channels are stored planar, so the taps are
+// contiguous. c2 is a reversed table row, which turns the backward
+// walk over the second half of the filter into a forward one.
+// The 1e-20 offset avoids denormals, as in the original loop.
+
+static float fir_scalar (const float *q1, const float *q2,
+                         const float *c1, const float *c2,
+                         unsigned int hl)
+{
+    float s = 1e-20f;
+    q2 += hl;
+    c2 += hl;
+    for (unsigned int i = 0; i < hl; i++)
+    {
+        q2--;
+        c2--;
+        s += q1 [i] * c1 [i] + *q2 * *c2;
+    }
+    return s - 1e-20f;
+}
+
+
+#ifdef RESAMPLER_X86
+
+__attribute__((target("sse")))
+static float fir_sse (const float *q1, const float *q2,
+                      const float *c1, const float *c2,
+                      unsigned int hl)
+{
+    unsigned int i = 0;
+    __m128 a = _mm_setzero_ps ();
+    for (; i + 4 <= hl; i += 4)
+    {
+        a = _mm_add_ps (a, _mm_mul_ps (_mm_loadu_ps (q1 + i), _mm_loadu_ps (c1 + i)));
+        a = _mm_add_ps (a, _mm_mul_ps (_mm_loadu_ps (q2 + i), _mm_loadu_ps (c2 + i)));
+    }
+    a = _mm_add_ps (a, _mm_movehl_ps (a, a));
+    a = _mm_add_ss (a, _mm_shuffle_ps (a, a, 1));
+    float s = 1e-20f + _mm_cvtss_f32 (a);
+    for (; i < hl; i++) s += q1 [i] * c1 [i] + q2 [i] * c2 [i];
+    return s - 1e-20f;
+}
+
+
+__attribute__((target("avx2,fma")))
+static float fir_avx2 (const float *q1, const float *q2,
+                       const float *c1, const float *c2,
+                       unsigned int hl)
+{
+    unsigned int i = 0;
+    __m256 a = _mm256_setzero_ps ();
+    __m256 b = _mm256_setzero_ps ();
+    for (; i + 8 <= hl; i += 8)
+    {
+        a = _mm256_fmadd_ps (_mm256_loadu_ps (q1 + i), _mm256_loadu_ps (c1 + i), a);
+        b = _mm256_fmadd_ps (_mm256_loadu_ps (q2 + i), _mm256_loadu_ps (c2 + i), b);
+    }
+    a = _mm256_add_ps (a, b);
+    __m128 h = _mm_add_ps (_mm256_castps256_ps128 (a), _mm256_extractf128_ps (a, 1));
+    h = _mm_add_ps (h, _mm_movehl_ps (h, h));
+    h = _mm_add_ss (h, _mm_shuffle_ps (h, h, 1));
+    float s = 1e-20f + _mm_cvtss_f32 (h);
+    for (; i < hl; i++) s += q1 [i] * c1 [i] + q2 [i] * c2 [i];
+    return s - 1e-20f;
+}
+
+
+__attribute__((target("avx512f")))
+static float fir_avx512 (const float *q1, const float *q2,
+                         const float *c1, const float *c2,
+                         unsigned int hl)
+{
+    unsigned int i = 0;
+    __m512 a = _mm512_setzero_ps ();
+    for (; i + 16 <= hl; i += 16)
+    {
+        a = _mm512_fmadd_ps (_mm512_loadu_ps (q1 + i), _mm512_loadu_ps (c1 + i), a);
+        a = _mm512_fmadd_ps (_mm512_loadu_ps (q2 + i), _mm512_loadu_ps (c2 + i), a);
+    }
+    if (i < hl)
+    {
+        // masked loads for the remaining taps
+        __mmask16 m = (__mmask16)((1u << (hl - i)) - 1);
+        a = _mm512_fmadd_ps (_mm512_maskz_loadu_ps (m, q1 + i), _mm512_maskz_loadu_ps (m, c1 + i), a);
+        a = _mm512_fmadd_ps (_mm512_maskz_loadu_ps (m, q2 + i), _mm512_maskz_loadu_ps (m, c2 + i), a);
+    }
+    // fold the 512 bit sum down to one float
+    float t [16];
+    _mm512_storeu_ps (t, a);
+    __m256 w = _mm256_add_ps (_mm256_loadu_ps (t), _mm256_loadu_ps (t + 8));
+    __m128 h = _mm_add_ps (_mm256_castps256_ps128 (w), _mm256_extractf128_ps (w, 1));
+    h = _mm_add_ps (h, _mm_movehl_ps (h, h));
+    h = _mm_add_ss (h, _mm_shuffle_ps (h, h, 1));
+    return (1e-20f + _mm_cvtss_f32 (h)) - 1e-20f;
+}
+
+#endif
+
+
+#ifdef RESAMPLER_NEON
+
+static float fir_neon (const float *q1, const float *q2,
+                       const float *c1, const float *c2,
+                       unsigned int hl)
+{
+    unsigned int i = 0;
+    float32x4_t a = vdupq_n_f32 (0.0f);
+    for (; i + 4 <= hl; i += 4)
+    {
+        a = vmlaq_f32 (a, vld1q_f32 (q1 + i), vld1q_f32 (c1 + i));
+        a = vmlaq_f32 (a, vld1q_f32 (q2 + i), vld1q_f32 (c2 + i));
+    }
+    float32x2_t h = vadd_f32 (vget_low_f32 (a), vget_high_f32 (a));
+    float s = 1e-20f + vget_lane_f32 (vpadd_f32 (h, h), 0);
+    for (; i < hl; i++) s += q1 [i] * c1 [i] + q2 [i] * c2 [i];
+    return s - 1e-20f;
+}
+
+#endif
+
+
+struct Resampler_dispatch
+{
+    const char       *name;
+    Resampler_kernel  fn;
+};
+
+
+// list the kernels the cpu supports, the widest first
+static unsigned int supported_kernels (Resampler_dispatch *list)
+{
+    unsigned int n = 0;
+#ifdef RESAMPLER_X86
+    __builtin_cpu_init ();
+    if (__builtin_cpu_supports ("avx512f")) list [n++] = { "avx512", fir_avx512 };
+    if (__builtin_cpu_supports ("avx2") && __builtin_cpu_supports ("fma")) list [n++] = { "avx2", fir_avx2 };
+    if (__builtin_cpu_supports ("sse")) list [n++] = { "sse", fir_sse };
+#endif
+#ifdef RESAMPLER_NEON
+    list [n++] = { "neon", fir_neon };
+#endif
+    list [n++] = { "scalar", fir_scalar };
+    return n;
+}
+
+
+// pick the widest kernel the cpu supports
+static Resampler_dispatch select_kernel (void)
+{
+    Resampler_dispatch list [5];
+    supported_kernels (list);
+    return list [0];
+}
+
+
+// The kernel is picked on first use. A file static initializer could
+// run after resamplers constructed by static initializers elsewhere.
+static const Resampler_dispatch &dispatch (void)
+{
+    static const Resampler_dispatch d = select_kernel ();
+    return d;
+}
+
+
+const char *Resampler::kernel_name (void)
+{
+    return dispatch ().name;
+}
+
+
+Resampler_kernel Resampler::kernel (void)
+{
+    return dispatch ().fn;
+}
+
+
+Resampler_kernel Resampler::kernel (const char *name)
+{
+    Resampler_dispatch list [5];
+    unsigned int n = supported_kernels (list);
+    for (unsigned int i = 0; i < n; i++)
+    {
+        if (! strcmp (list [i].name, name)) return list [i].fn;
+    }
+    return 0;
+}
+
+
 Resampler::Resampler (void) :
     _table (0),
     _nchan (0),
-    _buff  (0)
+    _bstep (0),
+    _buff  (0),
+    _kernel (0)
 {
     reset ();
 }
@@ -110,9 +308,11 @@ int Resampler::setup (unsigned int fs_inp,
     {
 	_table = T;
 	_buff  = B;
+	_bstep = 2 * T->_hl - 1 + k;
 	_nchan = nchan;
 	_inmax = k;
 	_pstep = s;
+	_kernel = kernel ();
 	return reset ();
     }
     else return 1;
@@ -126,6 +326,7 @@ void Resampler::clear (void)
     _buff  = 0;
     _table = 0;
     _nchan = 0;
+    _bstep = 0;
     _inmax = 0;
     _pstep = 0;
     reset ();
@@ -169,8 +370,7 @@ int Resampler::reset (void)
 
 int Resampler::process (void)
 {
-    unsigned int   hl, ph, np, dp, in, nr, nz, i, n, c;
-    float          *p1, *p2;
+    unsigned int   hl, ph, np, dp, in, nr, nz, i2, n, c, L;
 
     if (!_table) return 1;
 
@@ -181,9 +381,8 @@ int Resampler::process (void)
     nr = _nread;
     ph = _phase;
     nz = _nzero;
-    n = (2 * hl - nr) * _nchan;
-    p1 = _buff + in * _nchan;
-    p2 = p1 + n;
+    L  = _bstep;
+    i2 = in + 2 * hl - nr;
 
     while (out_count)
     {
@@ -192,17 +391,17 @@ int Resampler::process (void)
 	    if (inp_count == 0) break;
   	    if (inp_data)
 	    {
-                for (c = 0; c < _nchan; c++) p2 [c] = inp_data [c];
+                for (c = 0; c < _nchan; c++) _buff [c * L + i2] = inp_data [c];
 		inp_data += _nchan;
 		nz = 0;
 	    }
 	    else
 	    {
-                for (c = 0; c < _nchan; c++) p2 [c] = 0;
+                for (c = 0; c < _nchan; c++) _buff [c * L + i2] = 0;
 		if (nz < 2 * hl) nz++;
 	    }
 	    nr--;
-	    p2 += _nchan;
+	    i2++;
 	    inp_count--;
 	}
 	else
@@ -211,20 +410,12 @@ int Resampler::process (void)
 	    {
 		if (nz < 2 * hl)
 		{
-		    float *c1 = _table->_ctab + hl * ph;
-		    float *c2 = _table->_ctab + hl * (np - ph);
+		    const float *c1 = _table->_ctab + hl * ph;
+		    const float *c2 = _table->_rtab + hl * (np - ph);
 		    for (c = 0; c < _nchan; c++)
 		    {
-			float *q1 = p1 + c;
-			float *q2 = p2 + c;
-			float s = 1e-20f;
-			for (i = 0; i < hl; i++)
-			{
-			    q2 -= _nchan;
-			    s += *q1 * c1 [i] + *q2 * c2 [i];
-			    q1 += _nchan;
-			}
-			*out_data++ = s - 1e-20f;
+			const float *q = _buff + c * L + in;
+			*out_data++ = _kernel (q, q + hl, c1, c2, hl);
 		    }
 		}
 		else
@@ -240,15 +431,14 @@ int Resampler::process (void)
 		nr = ph / np;
 		ph -= nr * np;
 		in += nr;
-		p1 += nr * _nchan;;
 		if (in >= _inmax)
 		{
-		    n = (2 * hl - nr) * _nchan;
-		    memcpy (_buff, p1, n * sizeof (float));
+		    n = 2 * hl - nr;
+		    for (c = 0; c < _nchan; c++)
+			memmove (_buff + c * L, _buff + c * L + in, n * sizeof (float));
 		    in = 0;
-		    p1 = _buff;
-		    p2 = p1 + n;
 		}
+		i2 = in + 2 * hl - nr;
 	    }
 	}
     }
@@ -260,4 +450,3 @@ int Resampler::process (void)
     return 0;
 }
 
-
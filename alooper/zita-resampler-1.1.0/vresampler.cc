@@ -0,0 +1,324 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2006-2012 Fons Adriaensen <fons@linuxaudio.org>
+//    
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <zita-resampler/vresampler.h>
+
+
+// Max input frames per output frame, the table must cover the
+// steps, so hlen must be at least half of it.
+
+#define MAX_STEP 16.0
+
+
+VResampler::VResampler (void) :
+    _table (0),
+    _nchan (0),
+    _bstep (0),
+    _buff  (0),
+    _c1 (0),
+    _c2 (0),
+    _kernel (0),
+    _nband (0)
+{
+    for (unsigned int b = 0; b < NBAND; b++) _bands [b] = 0;
+    reset ();
+}
+
+
+VResampler::~VResampler (void)
+{
+    clear ();
+}
+
+
+int VResampler::setup (double       ratio,
+                       unsigned int nchan,
+                       unsigned int hlen)
+{
+    if ((hlen < 8) || (hlen > 96)) return 1;
+    return setup (ratio, nchan, hlen, 1.0 - 2.6 / hlen);
+}
+
+
+int VResampler::setup (double       ratio,
+                       unsigned int nchan,
+                       unsigned int hlen,
+                       double       frel)
+{
+    unsigned int       h, k;
+    float              *B = 0;
+    Resampler_table    *T = 0;
+
+    k = 0;
+    if (nchan && (hlen >= 8) && (hlen <= 96) && (16 * ratio >= 1) && (ratio <= 16))
+    {
+        h = hlen;
+        k = 250;
+        if (ratio < 1)
+        {
+            frel *= ratio;
+            h = (unsigned int)(ceil (h / ratio));
+            k = (unsigned int)(ceil (k / ratio));
+        }
+        T = Resampler_table::create (frel, h, NPHASE);
+        B = new float [nchan * (2 * h - 1 + k)];
+    }
+    clear ();
+    if (T)
+    {
+        _table = T;
+        _bands [0] = T;
+        _nband = 1;
+        _buff  = B;
+        _bstep = 2 * T->_hl - 1 + k;
+        _c1 = new float [T->_hl];
+        _c2 = new float [T->_hl];
+        _nchan = nchan;
+        _inmax = k;
+        _ratio = ratio;
+        _pstep = 1.0 / ratio;
+        _qstep = _pstep;
+        _wstep = 1;
+        // not taken in the constructor, a VResampler could be
+        // constructed before the kernel is picked
+        _kernel = Resampler::kernel ();
+        return reset ();
+    }
+    else return 1;
+}
+
+
+void VResampler::clear (void)
+{
+    for (unsigned int b = 0; b < _nband; b++)
+    {
+        Resampler_table::destroy (_bands [b]);
+        _bands [b] = 0;
+    }
+    _nband = 0;
+    delete[] _buff;
+    delete[] _c1;
+    delete[] _c2;
+    _buff  = 0;
+    _c1 = 0;
+    _c2 = 0;
+    _table = 0;
+    _nchan = 0;
+    _bstep = 0;
+    _inmax = 0;
+    _ratio = 1;
+    _pstep = 1;
+    _qstep = 1;
+    _wstep = 1;
+    reset ();
+}
+
+
+void VResampler::set_phase (double p)
+{
+    if (!_table) return;
+    _phase = (uint64_t)((p - floor (p)) * 4294967296.0);
+}
+
+
+void VResampler::set_rratio (double r)
+{
+    if (!_table) return;
+    if (r > 16.0) r = 16.0;
+    if (r < 0.95 / MAX_STEP) r = 0.95 / MAX_STEP;
+    _qstep = 1.0 / (_ratio * r);
+    if (_qstep > MAX_STEP) _qstep = MAX_STEP;
+    // the cutoff follow the step in octaves, so the
+    // input is band limited when it's read faster
+    unsigned int b = 0;
+    while ((b + 1 < _nband) && ((double)(1 << b) < _qstep * _ratio)) b++;
+    _table = _bands [b];
+}
+
+
+// Build the tables for steps up to s times the one of setup(),
+// band b move the stop band edge down to 1/2^b of the one of
+// setup(), with the same transition width and length of the
+// table, so set_rratio() could switch between them without a
+// allocation and without a gap in the input.
+
+int VResampler::set_maxstep (double s)
+{
+    if (!_table) return 1;
+    const unsigned int hl = _bands [0]->_hl;
+    const double w = 2.6 / hl;
+    const double edge = _bands [0]->_fr + w;
+    while ((_nband < NBAND) && ((double)(1 << (_nband - 1)) < s))
+    {
+        const double f = edge / (1 << _nband) - w;
+        if (f <= 0) return 1;
+        _bands [_nband] = Resampler_table::create (f, hl, NPHASE);
+        _nband++;
+    }
+    return 0;
+}
+
+
+void VResampler::set_rrfilt (double t)
+{
+    if (!_table) return;
+    _wstep = (t < 1) ? 1 : 1 - exp (-1 / t);
+}
+
+
+double VResampler::inpdist (void) const
+{
+    if (!_table) return 0;
+    return (int)(_table->_hl + 1 - _nread) - (double)_phase / 4294967296.0;
+}
+
+
+int VResampler::inpsize (void) const
+{
+    if (!_table) return 0;
+    return 2 * _table->_hl;
+}
+
+
+int VResampler::reset (void)
+{
+    if (!_table) return 1;
+
+    inp_count = 0;
+    out_count = 0;
+    inp_data = 0;
+    out_data = 0;
+    _index = 0;
+    _nread = 0;
+    _nzero = 0;
+    _phase = 0;
+    _pstep = _qstep;
+    if (_table)
+    {
+        _nread = 2 * _table->_hl;
+        return 0;
+    }
+    return 1;
+}
+
+
+int VResampler::process (void)
+{
+    unsigned int   hl, np, in, nr, nz, i2, n, c, i, k, L;
+    uint64_t       ph, dp;
+    double         dd;
+    float          a, b;
+
+    if (!_table) return 1;
+
+    hl = _table->_hl;
+    np = _table->_np;
+    in = _index;
+    nr = _nread;
+    ph = _phase;
+    nz = _nzero;
+    L  = _bstep;
+    i2 = in + 2 * hl - nr;
+
+    while (out_count)
+    {
+        if (nr)
+        {
+            if (inp_count == 0) break;
+            if (inp_data)
+            {
+                for (c = 0; c < _nchan; c++) _buff [c * L + i2] = inp_data [c];
+                inp_data += _nchan;
+                nz = 0;
+            }
+            else
+            {
+                for (c = 0; c < _nchan; c++) _buff [c * L + i2] = 0;
+                if (nz < 2 * hl) nz++;
+            }
+            nr--;
+            i2++;
+            inp_count--;
+        }
+        else
+        {
+            if (out_data)
+            {
+                if (nz < 2 * hl)
+                {
+                    // the table phase and the weight of the next one
+                    // come from the upper bits of the fraction
+                    k = (unsigned int)((ph * np) >> FRAC_BITS);
+                    b = (float)((ph * np) & 0xffffffffULL) * (1.0f / 4294967296.0f);
+                    a = 1.0f - b;
+                    const float *q1 = _table->_ctab + hl * k;
+                    const float *q2 = _table->_rtab + hl * (np - k);
+                    const float *q3 = q2 - hl;
+                    for (i = 0; i < hl; i++)
+                    {
+                        _c1 [i] = a * q1 [i] + b * q1 [i + hl];
+                        _c2 [i] = a * q2 [i] + b * q3 [i];
+                    }
+                    for (c = 0; c < _nchan; c++)
+                    {
+                        const float *q = _buff + c * L + in;
+                        *out_data++ = _kernel (q, q + hl, _c1, _c2, hl);
+                    }
+                }
+                else
+                {
+                    for (c = 0; c < _nchan; c++) *out_data++ = 0;
+                }
+            }
+            out_count--;
+
+            dd = _qstep - _pstep;
+            if (fabs (dd) < 1e-30) _pstep = _qstep;
+            else _pstep += _wstep * dd;
+            dp = (uint64_t)(_pstep * 4294967296.0);
+            ph += dp;
+            if (ph >> FRAC_BITS)
+            {
+                nr = (unsigned int)(ph >> FRAC_BITS);
+                ph &= 0xffffffffULL;
+                in += nr;
+                if (in >= _inmax)
+                {
+                    n = 2 * hl - nr;
+                    for (c = 0; c < _nchan; c++)
+                        memmove (_buff + c * L, _buff + c * L + in, n * sizeof (float));
+                    in = 0;
+                }
+                i2 = in + 2 * hl - nr;
+            }
+        }
+    }
+    _index = in;
+    _nread = nr;
+    _phase = ph;
+    _nzero = nz;
+
+    return 0;
+}
@@ -65,6 +65,7 @@ private:
     Resampler_table     *_next;
     unsigned int         _refc;
     float               *_ctab;
+    float               *_rtab;  // rows of _ctab in reversed order
     double               _fr;
     unsigned int         _hl;
     unsigned int         _np;
@@ -25,6 +25,12 @@
 #include <zita-resampler/resampler-table.h>
 
 
+// FIR kernel, sum of q1 [i] * c1 [i] + q2 [i] * c2 [i] for i < hl
+typedef float (*Resampler_kernel)(const float *q1, const float *q2,
+                                  const float *c1, const float *c2,
+                                  unsigned int hl);
+
+
 class Resampler
 {
 public:
@@ -51,6 +57,11 @@ public:
     double inpdist (void) const; 
     int    process (void);
 
+    static const char *kernel_name (void);
+    static Resampler_kernel kernel (void);
+    // the named kernel, 0 when the cpu doesn't support it
+    static Resampler_kernel kernel (const char *name);
+
     unsigned int         inp_count;
     unsigned int         out_count;
     float               *inp_data;
@@ -68,7 +79,9 @@ private:
     unsigned int         _nzero;
     unsigned int         _phase;
     unsigned int         _pstep;
-    float               *_buff;
+    unsigned int         _bstep;  // frames per channel in _buff
+    float               *_buff;   // planar, one row of _bstep per channel
+    Resampler_kernel     _kernel;
     void                *_dummy [8];
 };
 
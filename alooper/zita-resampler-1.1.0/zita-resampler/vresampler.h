@@ -0,0 +1,95 @@
+// ----------------------------------------------------------------------------
+//
+//  Copyright (C) 2006-2012 Fons Adriaensen <fons@linuxaudio.org>
+//    
+//  This program is free software; you can redistribute it and/or modify
+//  it under the terms of the GNU General Public License as published by
+//  the Free Software Foundation; either version 3 of the License, or
+//  (at your option) any later version.
+//
+//  This program is distributed in the hope that it will be useful,
+//  but WITHOUT ANY WARRANTY; without even the implied warranty of
+//  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//  GNU General Public License for more details.
+//
+//  You should have received a copy of the GNU General Public License
+//  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+// ----------------------------------------------------------------------------
+
+
+
+#ifndef __VRESAMPLER_H
+#define __VRESAMPLER_H
+
+
+#include <stdint.h>
+#include <zita-resampler/resampler.h>
+
+
+// Variable ratio resampler. The read position is a 32.32 fixed
+// point value in input frames, the filter coefficients are
+// interpolated between the two nearest phases of the table.
+
+class VResampler
+{
+public:
+
+    VResampler (void);
+    ~VResampler (void);
+
+    int  setup (double       ratio,
+                unsigned int nchan,
+                unsigned int hlen);
+
+    int  setup (double       ratio,
+                unsigned int nchan,
+                unsigned int hlen,
+                double       frel);
+
+    void   clear (void);
+    int    reset (void);
+    int    nchan (void) const { return _nchan; }
+    int    inpsize (void) const;
+    double inpdist (void) const;
+    int    process (void);
+
+    void set_phase (double p);
+    void set_rrfilt (double t);
+    void set_rratio (double r);
+    int  set_maxstep (double s);
+
+    unsigned int         inp_count;
+    unsigned int         out_count;
+    float               *inp_data;
+    float               *out_data;
+    void                *inp_list;
+    void                *out_list;
+
+private:
+
+    enum { NPHASE = 256, FRAC_BITS = 32, NBAND = 5 };
+
+    Resampler_table     *_table;
+    Resampler_table     *_bands [NBAND];  // cutoff divided by 2^b
+    unsigned int         _nband;
+    unsigned int         _nchan;
+    unsigned int         _inmax;
+    unsigned int         _index;
+    unsigned int         _nread;
+    unsigned int         _nzero;
+    uint64_t             _phase;  // read position in 1/2^32 input frames
+    double               _ratio;
+    double               _pstep;  // input frames per output frame
+    double               _qstep;  // target of _pstep
+    double               _wstep;  // smoothing of _pstep changes
+    unsigned int         _bstep;  // frames per channel in _buff
+    float               *_buff;   // planar, one row of _bstep per channel
+    float               *_c1;
+    float               *_c2;
+    Resampler_kernel     _kernel;
+    void                *_dummy [8];
+};
+
+
+#endif